@@ -88,38 +88,6 @@ namespace madness {
     }
   }
     
-    template <typename T, typename R, std::size_t NDIM>
-    std::vector< Function<TENSOR_RESULT_TYPE(T,R),NDIM> >
-    transform(World& world,
-              const std::vector< Function<T,NDIM> >& v,
-              const DistributedMatrix<R>& c,
-              bool fence=true) {
-        PROFILE_FUNC;
-        
-        typedef TENSOR_RESULT_TYPE(T,R) resultT;
-        long n = v.size();    // n is the old dimension
-        long m = c.rowdim();  // m is the new dimension
-        MADNESS_ASSERT(n==c.coldim());
-        
-        // new(i) = sum(j) old(j) c(j,i)
-        
-        Tensor<T> tmp(n,m);
-        c.copy_to_replicated(tmp); // for debugging
-        tmp = transpose(tmp);
-        
-        std::vector< Function<resultT,NDIM> > vc = zero_functions_compressed<resultT,NDIM>(world, m);
-        compress(world, v);
-        
-        for (int i=0; i<m; ++i) {
-            for (int j=0; j<n; ++j) {
-                if (tmp(j,i) != R(0.0)) vc[i].gaxpy(1.0,v[j],tmp(j,i),false);
-            }
-        }
-        
-        if (fence) world.gop.fence();
-        return vc;
-    }
-    
     template<int NDIM>
     struct unaryexp {
         void operator()(const Key<NDIM>& key, Tensor<double_complex>& t) const {
@@ -489,6 +457,37 @@ namespace madness {
         return dUT;
     }
     
+    distmatT SCF::localize_boys(World & world, const vecfuncT & mo,
+                                const std::vector<int> & set, const double thresh,
+                                const double thetamax, const bool randomize,
+                                const bool doprint) const {
+        PROFILE_MEMBER_FUNC(SCF);
+        START_TIMER(world);
+        const int64_t nmo = mo.size();
+        std::vector<distmatT> dip;
+        for (int axis = 0; axis < 3; ++axis) {
+            functionT fdip = factoryT(world).functor(
+                                                     functorT(new DipoleFunctor(axis))).initial_level(4);
+            dip.push_back(matrix_inner(column_distributed_matrix_distribution(world, nmo, nmo),
+                                       mo, mul_sparse(world, fdip, mo, vtol), true));
+        }
+        distmatT dUT = distributed_localize_boys(world, dip[0], dip[1], dip[2], set,
+                                                 thresh, thetamax, randomize, doprint);
+        END_TIMER(world, "Boys distributed ");
+        
+        return dUT;
+    }
+    
+    distmatT SCF::localize(World & world, const vecfuncT & mo,
+                           const std::vector<int> & set, const double thresh,
+                           const double thetamax, const bool randomize,
+                           const bool doprint) const {
+        if (param.localize_pm)
+            return localize_PM(world, mo, set, thresh, thetamax, randomize, doprint);
+        else
+            return localize_boys(world, mo, set, thresh, thetamax, randomize, doprint);
+    }
+    
     void SCF::analyze_vectors(World& world, const vecfuncT & mo, const tensorT& occ,
                               const tensorT& energy, const std::vector<int>& set) {
         START_TIMER(world);
@@ -1066,29 +1065,84 @@ namespace madness {
         return rho;
     }
     
+    std::vector<poperatorT> BSHOperatorPool::make(World& world, const tensorT& evals,
+                                                  double lo, double thresh) {
+        const int k = FunctionDefaults<3>::get_k();
+        if (thresh != this->thresh or lo != this->lo or k != this->k) {
+            ops.clear();
+            this->thresh = thresh;
+            this->lo = lo;
+            this->k = k;
+        }
+        ++ncall;
+        
+        int nmo = evals.dim(0);
+        std::vector<poperatorT> r(nmo);
+        long nmade = 0;
+        for (int i = 0; i < nmo; ++i) {
+            const long g = lround(std::log(sqrt(-2.0 * evals(i))) / thresh);
+            mapT::iterator it = ops.find(g);
+            if (it == ops.end()) {
+                poperatorT op(BSHOperatorPtr3D(world, std::exp(g * thresh), lo, thresh));
+                it = ops.insert(std::make_pair(g, std::make_pair(op, ncall))).first;
+                ++nmade;
+            }
+            it->second.second = ncall;
+            r[i] = it->second.first;
+        }
+        
+        // forget the operators unused in this call and the previous one
+        long nused = 0;
+        for (mapT::iterator it = ops.begin(); it != ops.end();) {
+            if (it->second.second < ncall - 1) {
+                ops.erase(it++);
+            }
+            else {
+                if (it->second.second == ncall) ++nused;
+                ++it;
+            }
+        }
+        if (world.rank() == 0)
+            printf("  bsh: %d orbitals share %ld operators, %ld made\n", nmo, nused, nmade);
+        return r;
+    }
+    
     std::vector<poperatorT> SCF::make_bsh_operators(World& world, const tensorT& evals) {
         PROFILE_MEMBER_FUNC(SCF);
         int nmo = evals.dim(0);
-        std::vector < poperatorT > ops(nmo);
+        tensorT eps = copy(evals);
         double tol = FunctionDefaults < 3 > ::get_thresh();
         for (int i = 0; i < nmo; ++i) {
-            double eps = evals(i);
-            if (eps > 0) {
+            if (eps(i) > 0) {
                 if (world.rank() == 0) {
-                    print("bsh: warning: positive eigenvalue", i, eps);
+                    print("bsh: warning: positive eigenvalue", i, eps(i));
                 }
-                eps = -0.1;
+                eps(i) = -0.1;
             }
-            
-            ops[i] = poperatorT(
-                                BSHOperatorPtr3D(world, sqrt(-2.0 * eps), param.lo, tol));
         }
         
-        return ops;
+        return bshpool.make(world, eps, param.lo, tol);
     }
     
+    /// the pair products psi[i]*f[j] of the pairs [lo,hi), not fenced
+    static vecfuncT exchange_products(const vecfuncT& psi, const vecfuncT& f,
+                                      const std::vector< std::pair<int,int> >& pairs,
+                                      const std::size_t lo, const std::size_t hi, const double tol) {
+        vecfuncT psif;
+        psif.reserve(hi-lo);
+        for (std::size_t p=lo; p<hi; ++p)
+            psif.push_back(mul_sparse(psi[pairs[p].first], f[pairs[p].second], tol, false));
+        return psif;
+    }
+
     /// apply the HF exchange on a set of orbitals
     
+    /// The pairs (i,j) are processed in blocks that fit into the memory
+    /// budget CalculationParameters::exchange_memory.  While the potentials
+    /// of one block are multiplied back, the pair products of the next block
+    /// are formed.  Pairs whose orbitals do not overlap in any box of the
+    /// screening level are skipped, and if psi==f only the pairs i>=j are
+    /// computed.
     /// @param[in]  world   the world
     /// @param[in]  occ     occupation numbers
     /// @param[in]  psi     the orbitals in the exchange operator
@@ -1102,67 +1156,102 @@ namespace madness {
         int nf = f.size();
         double tol = FunctionDefaults < 3 > ::get_thresh(); /// Important this is consistent with Coulomb
         vecfuncT Kf = zero_functions_compressed<double, 3>(world, nf);
-        reconstruct(world, psi);
-        norm_tree(world, psi);
-        if (!same) {
-            reconstruct(world, f);
-            norm_tree(world, f);
-        }
-        
-        //         // Smaller memory algorithm ... possible 2x saving using i-j sym
-        //         for(int i=0; i<nocc; ++i){
-        //             if(occ[i] > 0.0){
-        //                 vecfuncT psif = mul_sparse(world, psi[i], f, tol); /// was vtol
-        //                 truncate(world, psif);
-        //                 psif = apply(world, *coulop, psif);
-        //                 truncate(world, psif);
-        //                 psif = mul_sparse(world, psi[i], psif, tol); /// was vtol
-        //                 gaxpy(world, 1.0, Kf, occ[i], psif);
-        //             }
-        //         }
-        
-        // Larger memory algorithm ... use i-j sym if psi==f
-        vecfuncT psif;
+        if (nocc == 0 or nf == 0) return Kf;
+        
+        // screen the pairs with the support indices: a pair whose product is
+        // below the truncation threshold in all boxes of the coarse level is
+        // skipped.  Only the pairs sharing a box are visited.
+        const Level nscreen = SupportIndex<3>::default_level();
+        const double screen = psi[0].get_impl()->truncate_tol(tol, Key<3>(nscreen, Vector<Translation,3>(0l)));
+        SupportIndex<3> spsi, sf;
+        support_indices(world, psi, f, screen, spsi, sf, nscreen);
+        const std::vector< std::pair<int,int> > candidates = spsi.pairs(sf, screen, same);
+        
+        std::vector< std::pair<int,int> > pairs;
+        std::size_t c = 0;
         for (int i = 0; i < nocc; ++i) {
             int jtop = nf;
             if (same)
                 jtop = i + 1;
             for (int j = 0; j < jtop; ++j) {
-                psif.push_back(mul_sparse(psi[i], f[j], tol, false));
+                // K_j gets occ[i] psi_i (psi_i f_j), and K_i gets occ[j] psi_j (psi_j psi_i) if same
+                const bool overlaps = (c < candidates.size() and candidates[c] == std::make_pair(i,j));
+                if (overlaps) ++c;
+                if (occ[i] == 0.0 and (!same or occ[j] == 0.0)) continue;
+                if (overlaps or (same and i == j)) pairs.push_back(std::make_pair(i,j));
             }
         }
+        const long npair = same ? long(nocc)*(nocc+1)/2 : long(nocc)*nf;
+        const long nskip = npair - long(candidates.size());
+        SupportIndex<3>::count_screening(npair, nskip);
+        
+        // estimated memory of a pair: its product and its potential, each
+        // about the size of both orbitals.  Two blocks are alive at a time.
+        std::vector<double> psisize(nocc), fsize(nf);
+        for (int i = 0; i < nocc; ++i) psisize[i] = psi[i].size();
+        for (int j = 0; j < nf; ++j) fsize[j] = same ? psisize[j] : f[j].size();
+        const double budget = 0.5*param.exchange_memory*world.size()*1024*1024*1024;
+        std::vector<std::size_t> blockstart(1,0);
+        double blockmem = 0.0;
+        for (std::size_t p = 0; p < pairs.size(); ++p) {
+            const double mem = 2.0*sizeof(double)*(psisize[pairs[p].first] + fsize[pairs[p].second]);
+            if (budget > 0.0 and blockmem > 0.0 and blockmem + mem > budget) {
+                blockstart.push_back(p);
+                blockmem = 0.0;
+            }
+            blockmem += mem;
+        }
+        blockstart.push_back(pairs.size());
+        const std::size_t nblock = blockstart.size() - 1;
         
-        world.gop.fence();
-        truncate(world, psif);
-        psif = apply(world, *coulop, psif);
-        truncate(world, psif, tol);
-        reconstruct(world, psif);
-        norm_tree(world, psif);
-        vecfuncT psipsif = zero_functions<double, 3>(world, nf * nocc);
-        int ij = 0;
-        for (int i = 0; i < nocc; ++i) {
-            int jtop = nf;
-            if (same)
-                jtop = i + 1;
-            for (int j = 0; j < jtop; ++j, ++ij) {
-                psipsif[i * nf + j] = mul_sparse(psif[ij], psi[i], false);
+        vecfuncT next = exchange_products(psi, f, pairs, blockstart[0], blockstart[1], tol);
+        for (std::size_t iblock = 0; iblock < nblock; ++iblock) {
+            const double wall0 = wall_time();
+            const std::size_t lo = blockstart[iblock], hi = blockstart[iblock+1];
+            world.gop.fence();
+            vecfuncT psif;
+            psif.swap(next);
+            truncate(world, psif);
+            psif = apply(world, *coulop, psif);
+            truncate(world, psif, tol);
+            reconstruct(world, psif);
+            norm_tree(world, psif);
+            const double potmem = get_size(world, psif);
+            
+            // the products of the next block are formed along with this block's
+            if (iblock + 1 < nblock)
+                next = exchange_products(psi, f, pairs, hi, blockstart[iblock+2], tol);
+            vecfuncT psipsif;
+            std::vector<int> target;
+            std::vector<double> weight;
+            for (std::size_t p = lo; p < hi; ++p) {
+                const int i = pairs[p].first, j = pairs[p].second;
+                psipsif.push_back(mul_sparse(psif[p-lo], psi[i], tol, false));
+                target.push_back(j);
+                weight.push_back(occ[i]);
                 if (same && i != j) {
-                    psipsif[j * nf + i] = mul_sparse(psif[ij], psi[j], false);
+                    psipsif.push_back(mul_sparse(psif[p-lo], psi[j], tol, false));
+                    target.push_back(i);
+                    weight.push_back(occ[j]);
                 }
             }
+            world.gop.fence();
+            psif.clear();
+            compress(world, psipsif);
+            const double prodmem = get_size(world, psipsif);
+            for (std::size_t q = 0; q < psipsif.size(); ++q)
+                Kf[target[q]].gaxpy(1.0, psipsif[q], weight[q], false);
+            world.gop.fence();
+            psipsif.clear();
+            
+            if (world.rank() == 0 and nblock > 1)
+                printf("  exchange block %3lu/%lu %6lu pairs  potentials %7.3f GB  products %7.3f GB  %8.2fs\n",
+                       (unsigned long) (iblock + 1), (unsigned long) nblock, (unsigned long) (hi - lo),
+                       potmem, prodmem, wall_time() - wall0);
         }
-        world.gop.fence();
-        psif.clear();
-        world.gop.fence();
-        compress(world, psipsif);
-        for (int i = 0; i < nocc; ++i) {
-            for (int j = 0; j < nf; ++j) {
-                Kf[j].gaxpy(1.0, psipsif[i * nf + j], occ[i], false);
-            }
-        }
-        world.gop.fence();
-        psipsif.clear();
-        world.gop.fence();
+        if (world.rank() == 0 and nskip > 0)
+            printf("  exchange: %lu pairs in %lu blocks, %ld pairs screened\n",
+                   (unsigned long) pairs.size(), (unsigned long) nblock, nskip);
         
         truncate(world, Kf, tol);
         return Kf;
@@ -1398,9 +1487,11 @@ namespace madness {
         double trantol = vtol / std::min(30.0, double(psi.size()));
         int nmo = psi.size();
         
+        // the level shift is arbitrary, so orbitals of energies within 1%
+        // are shifted alike and share a BSH operator
         tensorT eps(nmo);
         for (int i = 0; i < nmo; ++i) {
-            eps(i) = std::min(-0.05, fock(i, i));
+            eps(i) = BSHOperatorPool::bucket_energy(std::min(-0.05, fock(i, i)), 0.01);
             fock(i, i) -= eps(i);
         }
         vecfuncT fpsi = transform(world, psi, fock, trantol, true);
@@ -1452,7 +1543,9 @@ namespace madness {
                                   const vecfuncT & Vpsi, const tensorT & occ, double & ekinetic) const {
         PROFILE_MEMBER_FUNC(SCF);
         START_TIMER(world);
-        tensorT pe = matrix_inner(world, Vpsi, psi, true);
+        // localized orbitals of disjoint support give no matrix elements
+        tensorT pe = param.localize ? matrix_inner_sparse(world, Vpsi, psi, vtol, true)
+                                    : matrix_inner(world, Vpsi, psi, true);
         END_TIMER(world, "PE matrix");
         /*START_TIMER(world);
         LoadBalanceDeux < 3 > lb(world);
@@ -1548,6 +1641,17 @@ namespace madness {
         return expB;
     }
     
+    /// solve F U = S U e, with LAPACK or the distributed Jacobi solver
+    void SCF::sygv_fock(World& world, const tensorT& fock, const tensorT& overlap,
+                        tensorT& U, tensorT& evals) const {
+        if (param.distributed_diag) {
+            sygv_jacobi(world, fock, overlap, U, evals);
+        }
+        else {
+            sygvp(world, fock, overlap, 1, U, evals);
+        }
+    }
+
     /// compute the unitary transformation that diagonalizes the fock matrix
     
     /// @param[in]  world   the world
@@ -1564,7 +1668,7 @@ namespace madness {
         
         START_TIMER(world);
         tensorT U;
-        sygvp(world, fock, overlap, 1, U, evals);
+        sygv_fock(world, fock, overlap, U, evals);
         END_TIMER(world, "Diagonalization Fock-mat w sygv");
         
         long nmo = fock.dim(0);
@@ -1691,26 +1795,40 @@ namespace madness {
         if (world.size() == 1)
             return;
         
+        // With measurements of the previous iterations the trees only provide
+        // the structure and the cost is the measured time
+        double measured = MeasuredCost<3>::enabled() ? MeasuredCost<3>::local_total() : 0.0;
+        world.gop.sum(measured);
+        const double scale = (measured > 0.0) ? 0.0 : 1.0;
+
         LoadBalanceDeux < 3 > lb(world);
         real_function_3d vnuc;
         if (param.psp_calc){
             vnuc = gthpseudopotential->vlocalpot();}
         else{
             vnuc = potentialmanager->vnuclear();}
-        lb.add_tree(vnuc, lbcost<double, 3>(vnucextra * 1.0, vnucextra * 8.0),
+        lb.add_tree(vnuc, lbcost<double, 3>(scale * vnucextra * 1.0, scale * vnucextra * 8.0),
                     false);
-        lb.add_tree(arho, lbcost<double, 3>(1.0, 8.0), false);
+        lb.add_tree(arho, lbcost<double, 3>(scale * 1.0, scale * 8.0), false);
         for (unsigned int i = 0; i < amo.size(); ++i) {
-            lb.add_tree(amo[i], lbcost<double, 3>(1.0, 8.0), false);
+            lb.add_tree(amo[i], lbcost<double, 3>(scale * 1.0, scale * 8.0), false);
         }
         if (param.nbeta && !param.spin_restricted) {
-            lb.add_tree(brho, lbcost<double, 3>(1.0, 8.0), false);
+            lb.add_tree(brho, lbcost<double, 3>(scale * 1.0, scale * 8.0), false);
             for (unsigned int i = 0; i < bmo.size(); ++i) {
-                lb.add_tree(bmo[i], lbcost<double, 3>(1.0, 8.0), false);
+                lb.add_tree(bmo[i], lbcost<double, 3>(scale * 1.0, scale * 8.0), false);
             }
         }
         world.gop.fence();
-        
+
+        if (measured > 0.0) {
+            lb.add_measured_cost(1.0, true);
+            const double imbalance = lb.imbalance(MeasuredCost<3>::cost_per_proc(world));
+            if (world.rank() == 0) print("load balancing on the measured cost, previous imbalance (max/avg)", imbalance);
+            MeasuredCost<3>::clear();
+            world.gop.fence();
+        }
+
         FunctionDefaults < 3 > ::redistribute(world, lb.load_balance(6.0)); // 6.0 needs retuning after vnucextra
     }
     
@@ -1718,15 +1836,16 @@ namespace madness {
                               int lo, int nfunc, double trantol) const {
         PROFILE_MEMBER_FUNC(SCF);
         for (unsigned int iter = 0; iter < subspace.size(); ++iter) {
-            vecfuncT& v = subspace[iter].first;
-            vecfuncT& r = subspace[iter].second;
+            vecfuncT v = subspace.u(iter);
+            vecfuncT r = subspace.r(iter);
             vecfuncT vnew = transform(world, vecfuncT(&v[lo], &v[lo + nfunc]), U, trantol, false);
             vecfuncT rnew = transform(world, vecfuncT(&r[lo], &r[lo + nfunc]), U, trantol, false);
 	    world.gop.fence();
 	    for (int i=0; i<nfunc; i++) {
-	      v[i] = vnew[i];
-	      r[i] = rnew[i];
+	      v[lo+i] = vnew[i];
+	      r[lo+i] = rnew[i];
 	    }
+	    subspace.set(iter, v, r);
         }
 	world.gop.fence();
     }
@@ -1735,15 +1854,16 @@ namespace madness {
                               int lo, int nfunc, double trantol) const {
         PROFILE_MEMBER_FUNC(SCF);
         for (unsigned int iter = 0; iter < subspace.size(); ++iter) {
-            vecfuncT& v = subspace[iter].first;
-            vecfuncT& r = subspace[iter].second;
-            vecfuncT vnew = transform(world, vecfuncT(&v[lo], &v[lo + nfunc]), dUT, false);
-            vecfuncT rnew = transform(world, vecfuncT(&r[lo], &r[lo + nfunc]), dUT, false);
+            vecfuncT v = subspace.u(iter);
+            vecfuncT r = subspace.r(iter);
+            vecfuncT vnew = transform(world, vecfuncT(&v[lo], &v[lo + nfunc]), dUT, trantol, false);
+            vecfuncT rnew = transform(world, vecfuncT(&r[lo], &r[lo + nfunc]), dUT, trantol, false);
 	    world.gop.fence();
 	    for (int i=0; i<nfunc; i++) {
-	      v[i] = vnew[i];
-	      r[i] = rnew[i];
+	      v[lo+i] = vnew[i];
+	      r[lo+i] = rnew[i];
 	    }
+	    subspace.set(iter, v, r);
         }
 	world.gop.fence();
     }
@@ -1788,13 +1908,13 @@ namespace madness {
         compress(world, vm, false);
         compress(world, rm, false);
         world.gop.fence();
-        subspace.push_back(pairvecfuncT(vm, rm));
+        subspace.push_back(vm, rm);
         int m = subspace.size();
         tensorT ms(m);
         tensorT sm(m);
         for (int s = 0; s < m; ++s) {
-            const vecfuncT & vs = subspace[s].first;
-            const vecfuncT & rs = subspace[s].second;
+            const vecfuncT & vs = subspace.u(s);
+            const vecfuncT & rs = subspace.r(s);
             for (unsigned int i = 0; i < vm.size(); ++i) {
                 ms[s] += vm[i].inner_local(rs[i]);
                 sm[s] += vs[i].inner_local(rm[i]);
@@ -1842,8 +1962,8 @@ namespace madness {
         vecfuncT bmo_new = zero_functions_compressed<double, 3>(world, bmo.size(), false);
         world.gop.fence();
         for (unsigned int m = 0; m < subspace.size(); ++m) {
-            const vecfuncT & vm = subspace[m].first;
-            const vecfuncT & rm = subspace[m].second;
+            const vecfuncT & vm = subspace.u(m);
+            const vecfuncT & rm = subspace.r(m);
             const vecfuncT vma(vm.begin(), vm.begin() + amo.size());
             const vecfuncT rma(rm.begin(), rm.begin() + amo.size());
             const vecfuncT vmb(vm.end() - bmo.size(), vm.end());
@@ -1858,7 +1978,7 @@ namespace madness {
         if (param.maxsub <= 1) {
             subspace.clear();
         } else if (subspace.size() == param.maxsub) {
-            subspace.erase(subspace.begin());
+            subspace.pop_front();
             Q = Q(Slice(1, -1), Slice(1, -1));
         }
         
@@ -2114,12 +2234,13 @@ namespace madness {
         const double trantol = vtol / std::min(30.0, double(amo.size()));
         const double tolloc = 1e-3;
         double update_residual = 0.0, bsh_residual = 0.0;
-        subspaceT subspace;
+        subspaceT subspace(world, param.subspace_dir);
         tensorT Q;
         bool do_this_iter = true;
         // Shrink subspace until stop localizing/canonicalizing
         int maxsub_save = param.maxsub;
         param.maxsub = 2;
+        if (param.loadbal_measured) MeasuredCost<3>::enable();
         
         for (int iter = 0; iter < param.maxiter; ++iter) {
             if (world.rank() == 0)
@@ -2132,20 +2253,20 @@ namespace madness {
             
             if (param.localize && do_this_iter) {
                 distmatT dUT;
-                dUT = localize_PM(world, amo, aset, tolloc, 0.25, iter == 0, true);
+                dUT = localize(world, amo, aset, tolloc, 0.25, iter == 0, true);
                 dUT.data().screen(trantol);
 
                 START_TIMER(world);
-                amo = transform(world, amo, dUT);
+                amo = transform(world, amo, dUT, trantol);
                 truncate(world, amo);
                 normalize(world, amo);
                 ////////////////////////////////////////////rotate_subspace(world, dUT, subspace, 0, amo.size(), trantol);
                 END_TIMER(world, "Rotate subspace");
                 if (!param.spin_restricted && param.nbeta != 0) {
-                    dUT = localize_PM(world, bmo, bset, tolloc, 0.25, iter == 0, true);
+                    dUT = localize(world, bmo, bset, tolloc, 0.25, iter == 0, true);
                     START_TIMER(world);
                     dUT.data().screen(trantol);
-                    bmo = transform(world, bmo, dUT);
+                    bmo = transform(world, bmo, dUT, trantol);
                     truncate(world, bmo);
                     normalize(world, bmo);
                     /////////////////////////////////////////////rotate_subspace(world, dUT, subspace, amo.size(), bmo.size(),trantol);
@@ -2283,6 +2404,7 @@ namespace madness {
             else if (param.nbeta != 0) {
                 ekinb = ekina;
             }
+            SupportIndex<3>::print_screening(world, "Fock build");
             
             if (!param.localize && do_this_iter) {
                 tensorT U = diag_fock_matrix(world, focka, amo, Vpsia, aeps, aocc,
@@ -2335,7 +2457,7 @@ namespace madness {
                     END_TIMER(world, "Overlap");
                     
                     START_TIMER(world);
-                    sygvp(world, focka, overlap, 1, U, aeps);
+                    sygv_fock(world, focka, overlap, U, aeps);
                     END_TIMER(world, "focka eigen sol");
                     
                     if (!param.localize) {
@@ -2352,7 +2474,7 @@ namespace madness {
                         END_TIMER(world, "Overlap");
                         
                         START_TIMER(world);
-                        sygvp(world, fockb, overlap, 1, U, beps);
+                        sygv_fock(world, fockb, overlap, U, beps);
                         END_TIMER(world, "fockb eigen sol");
                         
                         if (!param.localize) {
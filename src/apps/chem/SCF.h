@@ -53,6 +53,8 @@
 
 #include <madness/tensor/solvers.h>
 #include <madness/tensor/distributed_matrix.h>
+#include <madness/tensor/distributed_eigen.h>
+#include <examples/nonlinsol.h>
 
 
 namespace madness {
@@ -63,7 +65,7 @@ typedef std::shared_ptr< FunctionFunctorInterface<double,3> > functorT;
 typedef Function<double,3> functionT;
 typedef std::vector<functionT> vecfuncT;
 typedef std::pair<vecfuncT,vecfuncT> pairvecfuncT;
-typedef std::vector<pairvecfuncT> subspaceT;
+typedef OutOfCoreSubspace<vecfuncT> subspaceT;
 typedef Tensor<double> tensorT;
 typedef DistributedMatrix<double> distmatT;
 typedef FunctionFactory<double,3> factoryT;
@@ -84,6 +86,16 @@ typedef Convolution1D<double_complex> complex_operatorT;
                                 const bool randomize = true,
                                        const bool doprint = false);
 
+    extern distmatT distributed_localize_boys(World & world,
+                                const distmatT & dx,
+                                const distmatT & dy,
+                                const distmatT & dz,
+                                const std::vector<int> & set,
+                                const double thresh = 1e-9,
+                                const double thetamax = 0.5,
+                                const bool randomize = true,
+                                const bool doprint = false);
+
 inline double mask1(double x) {
     /* Iterated first beta function to switch smoothly
        from 0->1 in [0,1].  n iterations produce 2*n-1
@@ -137,7 +149,7 @@ public:
 };
 
 
-class AtomicBasisFunctor : public FunctionFunctorInterface<double,3> {
+class AtomicBasisFunctor : public SeparableFunctor<double,3> {
 private:
     const AtomicBasisFunction aofunc;
 
@@ -150,6 +162,14 @@ public:
         return aofunc(x[0], x[1], x[2]);
     }
 
+    long nterms() const {
+        return aofunc.get_shell().nprim();
+    }
+
+    void factor(long mu, std::size_t d, const double* x, int npt, double* f) const {
+        aofunc.factor(mu, d, x, npt, f);
+    }
+
     std::vector<coordT> special_points() const {
         return std::vector<coordT>(1,aofunc.get_coords_vec());
     }
@@ -258,6 +278,47 @@ struct lbcost {
 };
 
 
+/// Pool of BSH operators shared by orbitals of similar energy
+
+/// The operators are made for the mu = sqrt(-2 eps) of a geometric grid of
+/// relative spacing thresh, below the accuracy of their Gaussian fit, and
+/// orbitals of the same grid point share one operator.  Operators are kept
+/// until unused for two calls, so their fits and cached convolution
+/// matrices are made once rather than in every iteration.  Rounding the
+/// orbital energies with bucket_energy() before the level shift of the
+/// residual makes orbitals of similar energy share an operator exactly.
+class BSHOperatorPool {
+    typedef std::map< long, std::pair<poperatorT,long> > mapT; ///< grid point -> operator, last call used
+    mapT ops;
+    double thresh, lo;
+    int k;
+    long ncall;
+
+public:
+    BSHOperatorPool() : thresh(0.0), lo(0.0), k(0), ncall(0) {}
+
+    /// The energy of the geometric grid of relative spacing width nearest to eps < 0
+    static double bucket_energy(double eps, double width) {
+        const double b = std::floor(std::log(-eps)/std::log1p(width) + 0.5);
+        return -std::pow(1.0 + width, b);
+    }
+
+    /// The operators for the energies, made only for new grid points
+
+    /// The pool is emptied if thresh, lo or the wavelet order change.
+    std::vector<poperatorT> make(World& world, const tensorT& evals, double lo, double thresh);
+
+    /// The number of operators in the pool
+    std::size_t size() const {
+        return ops.size();
+    }
+
+    void clear() {
+        ops.clear();
+    }
+};
+
+
 struct CalculationParameters {
     // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
     // !!!                                                                   !!!
@@ -315,6 +376,10 @@ struct CalculationParameters {
     bool tdksprop;               ///< time-dependent Kohn-Sham equation propagate
     std::string nuclear_corrfac;	///< nuclear correlation factor
     bool psp_calc;                ///< pseudopotential calculation or all electron
+    bool loadbal_measured;        ///< load balance on the measured cost of apply, mul and compress
+    double exchange_memory;       ///< memory per process for the HF exchange pair products in GByte, 0 for no limit
+    bool distributed_diag;        ///< diagonalize the Fock matrix with the distributed Jacobi solver
+    std::string subspace_dir;     ///< directory for the KAIN subspace files, empty to keep the subspace in memory
 
     template <typename Archive>
     void serialize(Archive& ar) {
@@ -325,7 +390,8 @@ struct CalculationParameters {
         ar & nalpha & nbeta & nmo_alpha & nmo_beta & lo;
         ar & core_type & derivatives & conv_only_dens & dipole;
         ar & xc_data & protocol_data;
-        ar & gopt & gtol & gtest & gval & gprec & gmaxiter & algopt & tdksprop & psp_calc;
+        ar & gopt & gtol & gtest & gval & gprec & gmaxiter & algopt & tdksprop & psp_calc & loadbal_measured
+           & exchange_memory & distributed_diag & subspace_dir;
     }
 
     CalculationParameters()
@@ -377,6 +443,10 @@ struct CalculationParameters {
         , tdksprop(false)
         , nuclear_corrfac("none")
         , psp_calc(false)
+        , loadbal_measured(false)
+        , exchange_memory(2.0)
+        , distributed_diag(false)
+        , subspace_dir("")
     {}
 
 
@@ -559,6 +629,18 @@ struct CalculationParameters {
             else if (s == "psp_calc") {
               psp_calc = true;
             }
+            else if (s == "loadbal_measured") {
+                loadbal_measured = true;
+            }
+            else if (s == "exchange_memory") {
+                f >> exchange_memory;
+            }
+            else if (s == "distributed_diag") {
+                distributed_diag = true;
+            }
+            else if (s == "subspace_dir") {
+                f >> subspace_dir;
+            }
             else {
                 std::cout << "moldft: unrecognized input keyword " << s << std::endl;
                 MADNESS_EXCEPTION("input error",0);
@@ -628,6 +710,8 @@ struct CalculationParameters {
             madness::print("           core type ", core_type);
         madness::print(" initial guess basis ", aobasis);
         madness::print(" max krylov subspace ", maxsub);
+        if (subspace_dir != "")
+            madness::print("  krylov subspace in ", subspace_dir);
         madness::print("    compute protocol ", protocol_data);
         madness::print("  energy convergence ", econv);
         madness::print(" density convergence ", dconv);
@@ -658,6 +742,9 @@ struct CalculationParameters {
             madness::print("    calc derivatives ");
         if (dipole)
             madness::print("         calc dipole ");
+        madness::print("     exchange memory ", exchange_memory, "GByte");
+        if (distributed_diag)
+            madness::print("    fock eigensolver ", "distributed jacobi");
     }
 
     void gprint(World& world) const {
@@ -700,6 +787,7 @@ public:
     /// orbital energies for alpha and beta orbitals
     tensorT aeps, beps;
     poperatorT coulop;
+    BSHOperatorPool bshpool;
     std::vector< std::shared_ptr<real_derivative_3d> > gradop;
     double vtol;
     double current_energy;
@@ -787,6 +875,19 @@ public:
     		const double thresh = 1e-9, const double thetamax = 0.5,
     		const bool randomize = true, const bool doprint = false) const;
 
+    /// compute the unitary localization matrix according to Boys
+
+    /// The dipole matrices of the MOs are computed and kept distributed;
+    /// same parameters as localize_PM
+    distmatT localize_boys(World & world, const vecfuncT & mo, const std::vector<int> & set,
+    		const double thresh = 1e-9, const double thetamax = 0.5,
+    		const bool randomize = true, const bool doprint = false) const;
+
+    /// compute the localization matrix with the method selected in the parameters
+    distmatT localize(World & world, const vecfuncT & mo, const std::vector<int> & set,
+    		const double thresh = 1e-9, const double thetamax = 0.5,
+    		const bool randomize = true, const bool doprint = false) const;
+
 
     void analyze_vectors(World & world, const vecfuncT & mo, const tensorT & occ = tensorT(),
     		const tensorT & energy = tensorT(), const std::vector<int> & set = std::vector<int>());
@@ -833,12 +934,12 @@ public:
 
     functionT make_dft_potential(World & world, const vecfuncT& vf, int ispin, int what)
     {
-        return multiop_values<double, xc_potential, 3>(xc_potential(xc, ispin, what), vf);
+        return multiop_values_batched<double, xc_potential, 3>(xc_potential(xc, ispin, what), vf);
     }
 
     double make_dft_energy(World & world, const vecfuncT& vf, int ispin)
     {
-        functionT vlda = multiop_values<double, xc_functional, 3>(xc_functional(xc, ispin), vf);
+        functionT vlda = multiop_values_batched<double, xc_functional, 3>(xc_functional(xc, ispin), vf);
         return vlda.trace();
     }
 
@@ -874,6 +975,16 @@ public:
 
     tensorT matrix_exponential(const tensorT& A) const ;
 
+    /// solve F U = S U e, with LAPACK or the distributed Jacobi solver
+
+    /// @param[in]	world	the world
+    /// @param[in]	fock	the fock matrix
+    /// @param[in]	overlap	the overlap matrix of the orbitals
+    /// @param[out]	U	the eigenvectors as columns
+    /// @param[out]	evals	the eigenvalues in ascending order
+    void sygv_fock(World& world, const tensorT& fock, const tensorT& overlap,
+                   tensorT& U, tensorT& evals) const;
+
     /// compute the unitary transformation that diagonalizes the fock matrix
 
     /// @param[in]	world	the world
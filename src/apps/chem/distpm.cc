@@ -136,6 +136,61 @@ public:
     }
 };
 
+/// Bookkeeping for sweeps that skip pairs known to be below tolerance
+
+/// Each row of a localization ends with NSKIP elements describing its
+/// orbital: the sweep in which it was last rotated, the sweep to which the
+/// following bound refers, the largest pair angle seen so far in that
+/// sweep, and the largest pair angle in the sweep before.  If neither
+/// orbital of a pair was rotated during the previous sweep or so far in
+/// this one, the pair is unchanged since it was examined in the previous
+/// sweep, and its angle is bounded by the smaller of the two largest
+/// angles of that sweep.  If that bound is below the current tolerance
+/// the pair would not be rotated and is skipped.
+struct PairSkip {
+    static const int NSKIP = 4;
+
+    static void init(DistributedMatrix<double>& d) {
+        d.fill(PairSkip());
+    }
+
+    double operator()(int64_t i, int64_t j) const {
+        static const double initial[NSKIP] = {-1e6, -1e6, 0.0, 1e6};
+        return initial[j];
+    }
+
+    static void roll(double * restrict s, int iter) {
+        if (s[1] != iter) {
+            s[3] = (s[1] == iter-1) ? s[2] : 1e6;
+            s[1] = iter;
+            s[2] = 0.0;
+        }
+    }
+
+    static void note(double * restrict si, double * restrict sj, double angle) {
+        si[2] = std::max(si[2], angle);
+        sj[2] = std::max(sj[2], angle);
+    }
+
+    /// Updates the bookkeeping of the pair and returns true if it can be skipped
+    static bool skip(double * restrict si, double * restrict sj, int iter, double tol) {
+        roll(si, iter);
+        roll(sj, iter);
+        if (si[0] < iter-1 && sj[0] < iter-1) {
+            double bound = std::min(si[3], sj[3]);
+            if (bound < tol) {
+                note(si, sj, bound);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void rotated(double * restrict si, double * restrict sj, int iter) {
+        si[0] = sj[0] = iter;
+    }
+};
+
 class SystolicPMOrbitalLocalize : public SystolicMatrixAlgorithm<double> {
     const std::vector<int>& set;
     const std::vector<int>& at_to_bf;
@@ -147,14 +202,18 @@ class SystolicPMOrbitalLocalize : public SystolicMatrixAlgorithm<double> {
     const int natom;
     const int nao;
     const int nmo;
+    const bool doprint;
     int iter;    
     AtomicInt ndone_iter;
+    AtomicInt nskip_iter;
+    long nrot_total, nskip_total;
     
 
     // Applies rotation between orbitals i and j for Pipek Mezy
     void localize_PM_ij(const int seti, const int setj, 
                         double * restrict Ci, double * restrict Cj, 
-                        double * restrict Ui, double * restrict Uj)
+                        double * restrict Ui, double * restrict Uj,
+                        double * restrict Si, double * restrict Sj)
     {
         if(seti == setj){
             std::vector<double> Qi(natom), Qj(natom);
@@ -193,19 +252,26 @@ class SystolicPMOrbitalLocalize : public SystolicMatrixAlgorithm<double> {
                     double s = sin(theta);
                     drot(nao, Ci, Cj, s, c, 1);
                     drot(nmo, Ui, Uj, s, c, 1);
+                    PairSkip::rotated(Si, Sj, iter);
+                }
+                else {
+                    PairSkip::note(Si, Sj, fabs(theta));
                     // for(long a = 0;a < natom;++a){
                     //     Qi[a] = PM_q(Svec[a], Ci, Ci, at_to_bf[a], at_nbf[a]);
                     //     Qj[a] = PM_q(Svec[a], Cj, Cj, at_to_bf[a], at_nbf[a]);
                     // }
                 }
             }
+            else {
+                PairSkip::note(Si, Sj, sqrt(fabs(ovij)));
+            }
         }
     }
 
 
 public:
     
-    // A[i,...] = [ C[i,...],  U[i,...], Q[i,...] ]
+    // A[i,...] = [ C[i,...],  U[i,...], PairSkip data ]
     SystolicPMOrbitalLocalize(DistributedMatrix<double>& A, 
                               const std::vector<int>& set,
                               const std::vector<int>& at_to_bf,
@@ -216,6 +282,7 @@ public:
                               int natom,
                               int nao,
                               int nmo,
+                              bool doprint=false,
                               int tag=5555) 
     : SystolicMatrixAlgorithm<double>(A, tag, NTHREAD),
           set(set),
@@ -228,11 +295,14 @@ public:
           natom(natom),
           nao(nao),
           nmo(nmo),
-          iter(-1)
+          doprint(doprint),
+          iter(-1),
+          nrot_total(0),
+          nskip_total(0)
     {
         MADNESS_ASSERT(A.is_column_distributed());
         MADNESS_ASSERT(A.coldim() == nmo);
-        MADNESS_ASSERT(A.rowdim() == nao + nmo);
+        MADNESS_ASSERT(A.rowdim() == nao + nmo + PairSkip::NSKIP);
     }
 
     void start_iteration_hook(const TaskThreadEnv& env) {
@@ -241,16 +311,26 @@ public:
             //if (iter > 0) tol = std::max(0.1 * std::min(maxtheta, tol), thresh);
             if (iter > 0) tol = std::max(0.1 * tol, thresh);
             ndone_iter = 0;
+            nskip_iter = 0;
             //madness::print("start", SystolicMatrixAlgorithm::get_world().rank(),iter);
         }            
     }
 
     void end_iteration_hook(const TaskThreadEnv& env) {
         if(env.id() == 0) {
-            int ndone = ndone_iter;
-            SystolicMatrixAlgorithm<double>::get_world().gop.sum(ndone);
+            World& world = SystolicMatrixAlgorithm<double>::get_world();
+            int ndone = ndone_iter, nskip = nskip_iter;
+            world.gop.sum(ndone);
+            world.gop.sum(nskip);
             ndone_iter = ndone;
+            nrot_total += ndone;
+            nskip_total += nskip;
             //madness::print("end", SystolicMatrixAlgorithm::get_world().rank(),iter,ndone);
+            if (doprint && world.rank() == 0 && ndone == 0 && tol == thresh) {
+                const double npair = 0.5*nmo*(nmo-1)*(iter+1);
+                madness::print("PM localization: sweeps", iter+1, "rotations", nrot_total,
+                               "skipped pairs", nskip_total, "fraction", nskip_total/npair);
+            }
         }
     }        
 
@@ -265,10 +345,17 @@ public:
         double * restrict Cj = rowj;
         double * restrict Ui = Ci + nao;
         double * restrict Uj = Cj + nao;
- 
+        double * restrict Si = Ui + nmo;
+        double * restrict Sj = Uj + nmo;
+
+        if (set[i] == set[j] && PairSkip::skip(Si, Sj, iter, tol)) {
+            nskip_iter++;
+            return;
+        }
         localize_PM_ij(set[i], set[j],
                        Ci, Cj,
-                       Ui, Uj);
+                       Ui, Uj,
+                       Si, Sj);
     }
 };
 
@@ -304,10 +391,13 @@ DistributedMatrix<double> distributed_localize_PM(World & world,
     DistributedMatrix<double> dC = column_distributed_matrix<double>(world, nmo, nao);
     matrix_inner(dC, mo, ao);
 
-    DistributedMatrix<double> dA = concatenate_rows(dC,dU);
+    DistributedMatrix<double> dS = column_distributed_matrix<double>(world, nmo, PairSkip::NSKIP);
+    PairSkip::init(dS);
+
+    DistributedMatrix<double> dA = concatenate_rows(concatenate_rows(dC,dU),dS);
 
     // Run the systolic algorithm
-    world.taskq.add(new SystolicPMOrbitalLocalize(dA, set, at_to_bf, at_nbf, Svec, thresh, thetamax, natom, nao, nmo));
+    world.taskq.add(new SystolicPMOrbitalLocalize(dA, set, at_to_bf, at_nbf, Svec, thresh, thetamax, natom, nao, nmo, doprint));
     world.taskq.fence();
 
     //print("DONE",world.rank());
@@ -360,4 +450,170 @@ DistributedMatrix<double> distributed_localize_PM(World & world,
     //return U;
 }
 
+
+class SystolicBoysOrbitalLocalize : public SystolicMatrixAlgorithm<double> {
+    const std::vector<int>& set;
+    const double thresh;
+    const double thetamax;
+    double tol;
+    const int nmo;
+    const bool doprint;
+    int iter;
+    AtomicInt ndone_iter;
+    AtomicInt nskip_iter;
+    long nrot_total, nskip_total;
+
+    // Applies rotation between orbitals i and j for Boys
+    void localize_boys_ij(double * restrict rowi, double * restrict rowj,
+                          double * restrict Si, double * restrict Sj)
+    {
+        double aij = 0.0;
+        double bij = 0.0;
+        const double * restrict Ui = rowi;
+        const double * restrict Uj = rowj;
+        for (int axis=0; axis<3; ++axis) {
+            const double * restrict Di = rowi + (axis+1)*nmo;
+            const double * restrict Dj = rowj + (axis+1)*nmo;
+            double dii = 0.0, djj = 0.0, dij = 0.0;
+            for (int k=0; k<nmo; ++k) {
+                dii += Ui[k]*Di[k];
+                djj += Uj[k]*Dj[k];
+                dij += Ui[k]*Dj[k];
+            }
+            double d = dii - djj;
+            aij += dij * dij - 0.25 * d * d;
+            bij += dij * d;
+        }
+
+        // Same angle as 0.25*acos(-aij/sqrt(aij^2+bij^2)) with the sign of
+        // -bij, but accurate for small angles so that tight thresholds converge
+        double theta = 0.25 * atan2(-bij, -aij);
+
+        if (theta > thetamax)
+            theta = thetamax;
+        else if (theta < -thetamax)
+            theta = -thetamax;
+
+        if (fabs(theta) >= tol) {
+            ndone_iter++;
+            double c = cos(theta);
+            double s = sin(theta);
+            drot(4*nmo, rowi, rowj, s, c, 1);
+            PairSkip::rotated(Si, Sj, iter);
+        }
+        else {
+            PairSkip::note(Si, Sj, fabs(theta));
+        }
+    }
+
+public:
+
+    // A[i,...] = [ U[i,...], Dx U[i,...], Dy U[i,...], Dz U[i,...], PairSkip data ]
+    //
+    // The dipole matrix elements of the rotated orbitals are <i|x|j> = U[i,...] . Dx U[j,...]
+    // so only the rows of the two orbitals being rotated are needed.
+    SystolicBoysOrbitalLocalize(DistributedMatrix<double>& A,
+                                const std::vector<int>& set,
+                                double thresh,
+                                double thetamax,
+                                int nmo,
+                                bool doprint=false,
+                                int tag=5556)
+        : SystolicMatrixAlgorithm<double>(A, tag, NTHREAD),
+          set(set),
+          thresh(thresh),
+          thetamax(thetamax),
+          tol(0.1),
+          nmo(nmo),
+          doprint(doprint),
+          iter(-1),
+          nrot_total(0),
+          nskip_total(0)
+    {
+        MADNESS_ASSERT(A.is_column_distributed());
+        MADNESS_ASSERT(A.coldim() == nmo);
+        MADNESS_ASSERT(A.rowdim() == 4*nmo + PairSkip::NSKIP);
+    }
+
+    void start_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) {
+            iter++;
+            if (iter > 0) tol = std::max(0.1 * tol, thresh);
+            ndone_iter = 0;
+            nskip_iter = 0;
+        }
+    }
+
+    void end_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) {
+            World& world = SystolicMatrixAlgorithm<double>::get_world();
+            int ndone = ndone_iter, nskip = nskip_iter;
+            world.gop.sum(ndone);
+            world.gop.sum(nskip);
+            ndone_iter = ndone;
+            nrot_total += ndone;
+            nskip_total += nskip;
+            if (doprint && world.rank() == 0 && ndone == 0 && tol == thresh) {
+                const double npair = 0.5*nmo*(nmo-1)*(iter+1);
+                madness::print("Boys localization: sweeps", iter+1, "rotations", nrot_total,
+                               "skipped pairs", nskip_total, "fraction", nskip_total/npair);
+            }
+        }
+    }
+
+    bool converged(const TaskThreadEnv& env) const {
+        return (ndone_iter == 0 && tol == thresh);
+    }
+
+    void kernel(int i, int j, double * restrict rowi, double * restrict rowj) {
+        if (set[i] != set[j]) return;
+
+        double * restrict Si = rowi + 4*nmo;
+        double * restrict Sj = rowj + 4*nmo;
+        if (PairSkip::skip(Si, Sj, iter, tol)) {
+            nskip_iter++;
+            return;
+        }
+        localize_boys_ij(rowi, rowj, Si, Sj);
+    }
+};
+
+/// Boys localization of orbitals with distributed dipole matrices
+
+/// @param[in] dx,dy,dz Dipole matrices <i|x|j> etc. of the orbitals, column distributed
+/// @param[in] set Only orbitals within the same set will be mixed
+/// @return The transposed localization matrix, so that localized orbital i is sum_j U(i,j) mo[j]
+DistributedMatrix<double> distributed_localize_boys(World & world,
+                                                    const DistributedMatrix<double>& dx,
+                                                    const DistributedMatrix<double>& dy,
+                                                    const DistributedMatrix<double>& dz,
+                                                    const std::vector<int> & set,
+                                                    const double thresh = 1e-9,
+                                                    const double thetamax = 0.5,
+                                                    const bool randomize = true,
+                                                    const bool doprint = false)
+{
+    const long nmo = dx.coldim();
+    MADNESS_ASSERT(dx.rowdim() == nmo && long(set.size()) == nmo);
+
+    DistributedMatrix<double> dU = column_distributed_matrix<double>(world, nmo, nmo);
+    dU.fill_identity();
+
+    DistributedMatrix<double> dS = column_distributed_matrix<double>(world, nmo, PairSkip::NSKIP);
+    PairSkip::init(dS);
+
+    DistributedMatrix<double> dUD = concatenate_rows(concatenate_rows(dU,dx), concatenate_rows(dy,dz));
+    DistributedMatrix<double> dA = concatenate_rows(dUD,dS);
+
+    world.taskq.add(new SystolicBoysOrbitalLocalize(dA, set, thresh, thetamax, nmo, doprint));
+    world.taskq.fence();
+
+    dA.extract_columns(0,nmo-1,dU);
+
+    world.taskq.add(new SystolicFixOrbitalOrders(dU));
+    world.taskq.fence();
+
+    return dU;
+}
+
 }
@@ -0,0 +1,229 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+
+/// \file chem/intermediatestore.h
+/// \brief content-addressed disk store for intermediate functions
+
+#ifndef MADNESS_CHEM_INTERMEDIATESTORE_H__INCLUDED
+#define MADNESS_CHEM_INTERMEDIATESTORE_H__INCLUDED
+
+#include <madness/mra/mra.h>
+#include <madness/world/parar.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace madness {
+
+    /// everything an intermediate function depends on
+
+    /// Two intermediates are interchangeable if all parameters agree.  The
+    /// file name is derived from a hash of the parameters; the parameters
+    /// themselves are stored along with the function and compared on
+    /// loading, so that hash collisions and stale files are never reused.
+    struct IntermediateKey {
+        std::string name;           ///< name of the intermediate, including orbital indices
+        double coord_chksum;        ///< check sum of the molecular geometry
+        double thresh;              ///< accuracy threshold of the intermediate
+        int k;                      ///< polynomial order of the intermediate
+        std::string parameters;     ///< operator and reference parameters, free format
+
+        IntermediateKey() : coord_chksum(0.0), thresh(0.0), k(0) {}
+
+        IntermediateKey(const std::string& name, const double coord_chksum,
+                        const double thresh, const int k, const std::string& parameters)
+            : name(name), coord_chksum(coord_chksum), thresh(thresh), k(k)
+            , parameters(parameters) {}
+
+        /// a complete description of the key, doubles are stored exactly
+        std::string description() const {
+            std::ostringstream s;
+            s.precision(17);
+            s << name << " " << coord_chksum << " " << thresh << " " << k << " " << parameters;
+            return s.str();
+        }
+
+        /// the file name in the store
+        std::string filename() const {
+            char buf[32];
+            sprintf(buf, "%016lx", (unsigned long) hash_value(description()));
+            return name + "_" + buf;
+        }
+
+        bool operator==(const IntermediateKey& other) const {
+            return description() == other.description();
+        }
+
+        template <typename Archive> void serialize(Archive& ar) {
+            ar & name & coord_chksum & thresh & k & parameters;
+        }
+    };
+
+
+    /// content-addressed store for intermediate functions on disk
+
+    /// Intermediates are stored under their IntermediateKey in a directory,
+    /// and are reused across runs only if the key matches exactly.  The size
+    /// of the store is limited; when the capacity is exceeded the least
+    /// recently used intermediates are removed.  The index of the store
+    /// is a text file in the directory, which is read and written by
+    /// process 0 on every access, so that several stores can share the same
+    /// directory.
+    class IntermediateStore {
+
+        World& world;
+        std::string dir_;           ///< directory of the store
+        double capacity_;           ///< capacity of the store in GByte, 0 turns the store off
+
+        /// one entry of the index: last use and size in bytes
+        typedef std::map<std::string, std::pair<long, long> > indexT;
+
+        std::string path(const std::string& file) const {return dir_ + "/" + file;}
+
+        /// read the index; on process 0 only
+        indexT read_index() const {
+            indexT index;
+            std::ifstream f(path("index").c_str());
+            std::string file;
+            long lastuse, bytes;
+            while (f >> file >> lastuse >> bytes) index[file] = std::make_pair(lastuse, bytes);
+            return index;
+        }
+
+        /// write the index; on process 0 only
+        void write_index(const indexT& index) const {
+            std::ofstream f(path("index").c_str());
+            for (indexT::const_iterator it = index.begin(); it != index.end(); ++it)
+                f << it->first << " " << it->second.first << " " << it->second.second << "\n";
+        }
+
+        /// the next value of the use counter
+        static long next_use(const indexT& index) {
+            long last = 0;
+            for (indexT::const_iterator it = index.begin(); it != index.end(); ++it)
+                last = std::max(last, it->second.first);
+            return last + 1;
+        }
+
+        /// mark file as used, record its size, and evict the least recently used files
+        void touch(const std::string& file) const {
+            if (world.rank() != 0) return;
+            indexT index = read_index();
+            struct stat s;
+            const long bytes = (stat((path(file) + ".00000").c_str(), &s) == 0) ? long(s.st_size) : 0;
+            index[file] = std::make_pair(next_use(index), bytes);
+
+            double total = 0.0;
+            for (indexT::const_iterator it = index.begin(); it != index.end(); ++it)
+                total += it->second.second;
+            while (total > capacity_*1024*1024*1024 and index.size() > 1) {
+                indexT::iterator lru = index.begin();
+                for (indexT::iterator it = index.begin(); it != index.end(); ++it)
+                    if (it->second.first < lru->second.first) lru = it;
+                print("intermediate store: evicting", lru->first);
+                ::remove((path(lru->first) + ".00000").c_str());
+                total -= lru->second.second;
+                index.erase(lru);
+            }
+            write_index(index);
+        }
+
+    public:
+
+        /// ctor
+
+        /// @param[in]  world       the world
+        /// @param[in]  dir         the directory of the store, created if necessary
+        /// @param[in]  capacity    the capacity in GByte, 0 turns the store off
+        IntermediateStore(World& world, const std::string& dir="intermediates",
+                          const double capacity=10.0)
+            : world(world), dir_(dir), capacity_(capacity) {
+            if (enabled() and world.rank() == 0) mkdir(dir_.c_str(), 0755);
+        }
+
+        /// change the capacity of the store in GByte, 0 turns the store off
+        void set_capacity(const double capacity) {
+            capacity_ = capacity;
+            if (enabled() and world.rank() == 0) mkdir(dir_.c_str(), 0755);
+        }
+
+        bool enabled() const {return capacity_ > 0.0;}
+
+        /// load an intermediate, if one with a matching key is in the store
+
+        /// @param[out] f       the intermediate, unchanged if not found
+        /// @param[in]  key     the key of the intermediate
+        /// @return     true if the intermediate was found
+        template <typename T, std::size_t NDIM>
+        bool load(Function<T,NDIM>& f, const IntermediateKey& key) const {
+            if (not enabled()) return false;
+            const std::string file = key.filename();
+            if (not archive::ParallelInputArchive::exists(world, path(file).c_str())) return false;
+
+            archive::ParallelInputArchive ar(world, path(file).c_str());
+            IntermediateKey stored;
+            ar & stored;
+            if (not (stored == key)) {
+                if (world.rank() == 0) print("intermediate store: key mismatch for", file);
+                return false;
+            }
+            ar & f;
+            touch(file);
+            if (world.rank() == 0) print("intermediate store: reusing", key.description());
+            return true;
+        }
+
+        /// store an intermediate
+
+        /// @param[in]  f       the intermediate
+        /// @param[in]  key     the key of the intermediate
+        template <typename T, std::size_t NDIM>
+        void store(const Function<T,NDIM>& f, const IntermediateKey& key) const {
+            if (not enabled()) return;
+            const std::string file = key.filename();
+            {
+                archive::ParallelOutputArchive ar(world, path(file).c_str(), 1);
+                ar & key;
+                ar & f;
+            }
+            touch(file);
+            world.gop.fence();
+        }
+    };
+
+}
+
+#endif // MADNESS_CHEM_INTERMEDIATESTORE_H__INCLUDED
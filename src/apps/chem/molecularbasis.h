@@ -167,6 +167,21 @@ public:
     }
 
 
+    /// Returns the powers of x, y and z in the angular part of basis function \c ibf (ordering as in eval)
+    void angular_powers(int ibf, int& ix, int& iy, int& iz) const {
+        static const int powers[4][10][3] = {
+            {{0,0,0}},
+            {{1,0,0},{0,1,0},{0,0,1}},
+            {{2,0,0},{1,1,0},{1,0,1},{0,2,0},{0,1,1},{0,0,2}},
+            {{3,0,0},{2,1,0},{2,0,1},{1,2,0},{1,1,1},{1,0,2},{0,3,0},{0,2,1},{0,1,2},{0,0,3}}
+        };
+        MADNESS_ASSERT(type>=0 && type<=3 && ibf<numbf && ibf>=0);
+        ix = powers[type][ibf][0];
+        iy = powers[type][ibf][1];
+        iz = powers[type][ibf][2];
+    }
+
+
     /// Returns the shell angular momentum
     int angular_momentum() const {
         return type;
@@ -386,6 +401,23 @@ public:
         return bf[ibf];
     }
 
+    /// Evaluates the factor in dimension d of primitive p at the npt points x
+
+    /// Each primitive is a product of 1D factors, c_p x^i exp(-a_p x^2) y^j
+    /// exp(-a_p y^2) z^k exp(-a_p z^2), relative to the center; the
+    /// contraction coefficient is included in the x factor.
+    void factor(int p, int d, const double* x, int npt, double* f) const {
+        int ipow[3];
+        shell.angular_powers(ibf, ipow[0], ipow[1], ipow[2]);
+        const double center = (d == 0) ? xx : ((d == 1) ? yy : zz);
+        const double a = shell.get_expnt()[p];
+        const double c = (d == 0) ? shell.get_coeff()[p] : 1.0;
+        for (int i=0; i<npt; ++i) {
+            const double dx = x[i] - center;
+            f[i] = c*exp(-a*dx*dx)*std::pow(dx,ipow[d]);
+        }
+    }
+
     void print_me(std::ostream& s) const;
 
     const ContractedGaussianShell& get_shell() const {
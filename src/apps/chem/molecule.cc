@@ -605,6 +605,45 @@ double Molecule::nuclear_attraction_potential(double x, double y, double z) cons
     return sum;
 }
 
+void Molecule::nuclear_attraction_potential(const double* x, const double* y, const double* z,
+                                            double* v, int npt) const {
+    // Atom by atom over a block of points so the distance loop
+    // vectorizes; only points inside the smoothing radius (r*rcut < 7,
+    // where smoothed_potential differs from 1/r) take the scalar path.
+    static const double rsmooth = 7.0;
+    for (int i=0; i<npt; ++i) v[i] = field[0]*x[i] + field[1]*y[i] + field[2]*z[i];
+
+    const int nblock = 256;
+    double r[nblock];
+    for (int lo=0; lo<npt; lo+=nblock) {
+        const int n = std::min(nblock, npt-lo);
+        const double* xb = x+lo;
+        const double* yb = y+lo;
+        const double* zb = z+lo;
+        double* vb = v+lo;
+        for (unsigned int a=0; a<atoms.size(); ++a) {
+            const double ax = atoms[a].x, ay = atoms[a].y, az = atoms[a].z;
+            const double q = atoms[a].q, rc = rcut[a];
+            const double rmin = rsmooth/rc;
+            bool smooth = false;
+            for (int i=0; i<n; ++i) {
+                const double dx = xb[i]-ax, dy = yb[i]-ay, dz = zb[i]-az;
+                r[i] = sqrt(dx*dx + dy*dy + dz*dz);
+                smooth |= (r[i] <= rmin);
+            }
+            if (smooth) {
+                for (int i=0; i<n; ++i) {
+                    if (r[i] <= rmin) vb[i] -= q*smoothed_potential(r[i]*rc)*rc;
+                    else vb[i] -= q/r[i];
+                }
+            }
+            else {
+                for (int i=0; i<n; ++i) vb[i] -= q/r[i];
+            }
+        }
+    }
+}
+
 double Molecule::nuclear_attraction_potential_derivative(int atom, int axis, double x, double y, double z) const {
     double r = distance(atoms[atom].x, atoms[atom].y, atoms[atom].z, x, y, z);
     double rc = rcut[atom];
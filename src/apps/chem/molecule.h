@@ -213,6 +213,10 @@ public:
 
     double nuclear_attraction_potential(double x, double y, double z) const;
 
+    /// Evaluates the nuclear attraction potential at npt points with coordinates x[i], y[i], z[i]
+    void nuclear_attraction_potential(const double* x, const double* y, const double* z,
+                                      double* v, int npt) const;
+
     double molecular_core_potential(double x, double y, double z) const;
 
     double core_potential_derivative(int atom, int axis, double x, double y, double z) const;
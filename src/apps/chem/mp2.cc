@@ -77,7 +77,8 @@ namespace madness {
 	/// ctor
 	MP2::MP2(World& world, const std::string& input) :
 			world(world), param(input.c_str()), corrfac(world), correlation_energy(
-					0.0), coords_sum(-1.0), do_coupling(false), Q12(world), intermediates() {
+					0.0), coords_sum(-1.0), do_coupling(false), Q12(world), intermediates(),
+					inputfile(input), cache(world, "intermediates", param.cache_capacity) {
 
 		{
 			std::shared_ptr<SCF> calc = std::shared_ptr<SCF>(
@@ -166,23 +167,7 @@ namespace madness {
 		coords_sum = xsq;
 		MADNESS_ASSERT(std::fabs(coord_chksum() - hf->coord_chksum()) < 1.e-14);
 
-		// set all orbitals spaces
-		// When a nuclear correlation factor is used the residual equations
-		// are similarity transformed. Therefore the orbitals in the
-		// projection operator must be set accordingly.
-		if (nuclear_corrfac->type() == NuclearCorrelationFactor::None) {
-			Q12.set_spaces(hf->get_calc().amo);
-		} else {
-			// only valid for closed shell
-			MADNESS_ASSERT(hf->get_calc().param.spin_restricted);
-			const std::vector<real_function_3d>& nemos = hf->nemos();
-			const std::vector<real_function_3d>& R2amo = hf->R2orbitals();
-			Q12.set_spaces(R2amo, nemos, R2amo, nemos);
-			if (world.rank() == 0) {
-				print("set orbital spaces for the SO projector");
-				print("Q12,R = (1-|nemo><nemo|R2) (1-|nemo><nemo|R2)");
-			}
-		}
+		set_orbital_spaces();
 
 		correlation_energy = 0.0;
 		if (world.rank()==0) print("localize ",hf->get_calc().param.localize);
@@ -195,6 +180,10 @@ namespace madness {
 					+ pair(param.i, param.j).e_triplet;
 
 		} else {
+			// solve the pairs on sub-worlds; they are read from disk below
+			if (param.nsubworld > 1 and world.size() > 1)
+				solve_on_subworlds(x);
+
 			// solve the residual equations for all pairs ij
 			for (int i = param.freeze; i < hf->nocc(); ++i) {
 				for (int j = i; j < hf->nocc(); ++j) {
@@ -236,6 +225,100 @@ namespace madness {
 		return correlation_energy;
 	}
 
+	/// set all orbital spaces
+
+	/// When a nuclear correlation factor is used the residual equations
+	/// are similarity transformed. Therefore the orbitals in the
+	/// projection operator must be set accordingly.
+	void MP2::set_orbital_spaces() {
+		if (nuclear_corrfac->type() == NuclearCorrelationFactor::None) {
+			Q12.set_spaces(hf->get_calc().amo);
+		} else {
+			// only valid for closed shell
+			MADNESS_ASSERT(hf->get_calc().param.spin_restricted);
+			const std::vector<real_function_3d>& nemos = hf->nemos();
+			const std::vector<real_function_3d>& R2amo = hf->R2orbitals();
+			Q12.set_spaces(R2amo, nemos, R2amo, nemos);
+			if (world.rank() == 0) {
+				print("set orbital spaces for the SO projector");
+				print("Q12,R = (1-|nemo><nemo|R2) (1-|nemo><nemo|R2)");
+			}
+		}
+	}
+
+	/// solve the unconverged pairs concurrently on sub-worlds
+	void MP2::solve_on_subworlds(const Tensor<double>& x) {
+		typedef std::shared_ptr< WorldDCPmapInterface< Key<3> > > pmap3T;
+		typedef std::shared_ptr< WorldDCPmapInterface< Key<6> > > pmap6T;
+
+		// the cost of a pair is estimated by the product of its orbital sizes
+		const std::vector<real_function_3d> amo = hf->orbitals();
+		std::vector<std::pair<int,int> > ij;
+		std::vector<double> cost;
+		for (int i = param.freeze; i < hf->nocc(); ++i) {
+			for (int j = i; j < hf->nocc(); ++j) {
+				if (pair(i,j).converged) continue;
+				ij.push_back(std::make_pair(i,j));
+				cost.push_back(double(amo[i].size())*double(amo[j].size()));
+			}
+		}
+		if (ij.size() == 0) return;
+
+		// assign the most expensive pair to the least loaded sub-world;
+		// all processes compute the same assignment
+		const int nsub = std::min(param.nsubworld, world.size());
+		std::vector<std::pair<double,int> > order(ij.size());
+		for (std::size_t p = 0; p < ij.size(); ++p) order[p] = std::make_pair(-cost[p], int(p));
+		std::sort(order.begin(), order.end());
+		std::vector<double> load(nsub, 0.0);
+		std::vector<int> owner(ij.size());
+		for (std::size_t p = 0; p < order.size(); ++p) {
+			const int isub = std::min_element(load.begin(), load.end()) - load.begin();
+			owner[order[p].second] = isub;
+			load[isub] -= order[p].first;
+		}
+		if (world.rank() == 0) {
+			printf("solving %d pairs on %d sub-worlds\n", int(ij.size()), nsub);
+			for (std::size_t p = 0; p < ij.size(); ++p)
+				printf("  pair (%d, %d) on sub-world %d\n", ij[p].first, ij[p].second, owner[p]);
+		}
+
+		// the sub-worlds read the reference from disk
+		hf->nemo_calc.get_calc()->save_mos(world);
+		world.gop.fence();
+
+		const pmap3T pmap3 = FunctionDefaults<3>::get_pmap();
+		const pmap6T pmap6 = FunctionDefaults<6>::get_pmap();
+		const int color = world.rank() % nsub;
+		SafeMPI::Intracomm comm = world.mpi.comm().Split(color, world.rank());
+		{
+			World subworld(comm);
+			FunctionDefaults<3>::set_pmap(pmap3T(new LevelPmap< Key<3> >(subworld)));
+			FunctionDefaults<6>::set_pmap(pmap6T(new LevelPmap< Key<6> >(subworld)));
+			{
+				MP2 sub(subworld, inputfile);
+				sub.hf->nemo_calc.get_calc()->param.no_compute = true;
+				sub.hf->value(x);
+				sub.coords_sum = x.sumsq();
+				sub.set_orbital_spaces();
+				for (std::size_t p = 0; p < ij.size(); ++p) {
+					if (owner[p] != color) continue;
+					const int i = ij[p].first, j = ij[p].second;
+					const double wall0 = wall_time();
+					sub.pair(i,j) = sub.make_pair(i,j);
+					sub.solve_residual_equations(sub.pair(i,j));	// stores the pair
+					if (subworld.rank() == 0)
+						printf("sub-world %d solved pair (%d, %d) in %.1fs\n",
+								color, i, j, wall_time() - wall0);
+				}
+			}
+			subworld.gop.fence();
+		}
+		FunctionDefaults<3>::set_pmap(pmap3);
+		FunctionDefaults<6>::set_pmap(pmap6);
+		world.gop.fence();
+	}
+
 	/// print the SCF parameters
 	void MP2::print_info(World& world) const {
 		if (world.rank() == 0) {
@@ -534,6 +617,22 @@ namespace madness {
 		return e;
 	}
 
+	/// the key of an intermediate of pair ij in the intermediate store
+	IntermediateKey MP2::intermediate_key(const std::string& name,
+			const int i, const int j) const {
+		std::ostringstream parameters;
+		parameters.precision(17);
+		parameters << "gamma " << corrfac.gamma()
+				<< " ncf " << int(nuclear_corrfac->type())
+				<< " thresh3 " << FunctionDefaults<3>::get_thresh()
+				<< " k3 " << FunctionDefaults<3>::get_k()
+				<< " localize " << hf->get_calc().param.localize
+				<< " nocc " << hf->nocc();
+		return IntermediateKey(name + "_" + stringify(i) + "_" + stringify(j),
+				coord_chksum(), FunctionDefaults<6>::get_thresh(),
+				FunctionDefaults<6>::get_k(), parameters.str());
+	}
+
 	/// save a function
 	template<typename T, size_t NDIM>
 	void MP2::save_function(const Function<T, NDIM>& f,
@@ -560,9 +659,10 @@ namespace madness {
 		const int i = pair.i;
 		const int j = pair.j;
 		real_function_6d Uphi0 = real_factory_6d(world);
+		const IntermediateKey key = intermediate_key("Uphi0", i, j);
 		if (not intermediates.Uphi0.empty()) {
 			load_function(Uphi0, intermediates.Uphi0);
-		} else {
+		} else if (not cache.load(Uphi0, key)) {
 			// apply the pure commutator of the kinetic energy and the
 			// electronic correlation factor on the (regularized)
 			// orbitals i and j
@@ -657,7 +757,7 @@ namespace madness {
 			asymmetry(Uphi0, "Uphi0");
 
 			// save the function for restart
-			//                save_function(Uphi0,"Uphi0");
+			cache.store(Uphi0, key);
 		}
 
 		// sanity check: <ij| [T,g12] |ij> = <ij | U |ij> - <ij| g12 | ij> = 0
@@ -689,10 +789,11 @@ namespace madness {
 		const int j = pair.j;
 
 		real_function_6d KffKphi0;
+		const IntermediateKey key = intermediate_key("KffKphi0", i, j);
 		if (not intermediates.KffKphi0.empty()) {
 			load_function(KffKphi0, intermediates.KffKphi0);
 
-		} else {
+		} else if (not cache.load(KffKphi0, key)) {
 			real_function_6d r12nemo = CompositeFactory<double, 6, 3>(world).g12(
 					corrfac.f()).particle1(copy(hf->nemo(i))).particle2(
 					copy(hf->nemo(j)));
@@ -768,7 +869,7 @@ namespace madness {
 					printf("< nemo0 | R^2 R-1 f K R | nemo0 >  %12.8f\n", a2);
 			}
 			KffKphi0 = (Kfphi0 - fKphi0).truncate().reduce_rank();
-			//				save_function(KffKphi0,"KffKphi0");
+			cache.store(KffKphi0, key);
 		}
 
 		// sanity check
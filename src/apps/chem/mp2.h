@@ -54,6 +54,7 @@
 #include <chem/projector.h>
 #include <chem/correlationfactor.h>
 #include <chem/nemo.h>
+#include <chem/intermediatestore.h>
 
 #include <iostream>
 
@@ -384,9 +385,20 @@ namespace madness {
         	/// maximum number of microiterations
         	int maxiter;
 
+        	/// number of sub-worlds on which the pairs are solved concurrently
+
+        	/// the processes are split into this many sub-worlds, each of
+        	/// which solves a subset of the pairs; the pairs are stored on
+        	/// disk and read back by the full world
+        	int nsubworld;
+
+        	/// capacity of the intermediate store in GByte, 0 turns it off
+        	double cache_capacity;
+
         	/// ctor reading out the input file
         	Parameters(const std::string& input) : thresh_(-1.0), dconv_(-1.0),
-        			i(-1), j(-1), freeze(0), restart(false), maxsub(2), maxiter(20) {
+        			i(-1), j(-1), freeze(0), restart(false), maxsub(2), maxiter(20),
+        			nsubworld(1), cache_capacity(10.0) {
 
         		// get the parameters from the input file
                 std::ifstream f(input.c_str());
@@ -401,6 +413,8 @@ namespace madness {
                     else if (s == "maxsub") f >> maxsub;
                     else if (s == "freeze") f >> freeze;
                     else if (s == "restart") restart=true;
+                    else if (s == "subworlds") f >> nsubworld;
+                    else if (s == "cache_capacity") f >> cache_capacity;
                     else continue;
                 }
                 // set default for dconv if not explicitly given
@@ -471,6 +485,8 @@ namespace madness {
 
         Intermediates intermediates;
         std::shared_ptr<real_convolution_3d> poisson;
+        std::string inputfile;					///< the input file, read again on the sub-worlds
+        IntermediateStore cache;				///< intermediates reused across runs
 
     public:
 
@@ -528,6 +544,13 @@ namespace madness {
         /// solve the couple MP1 equations for local orbitals
         void solve_coupled_equations(pairmapT& pairs) const;
 
+        /// solve the unconverged pairs concurrently on sub-worlds
+
+        /// the pairs are assigned to the sub-worlds by their estimated cost
+        /// and stored on disk, from where they are read by make_pair
+        /// @param[in]	x	the coordinates of the molecule
+        void solve_on_subworlds(const Tensor<double>& x);
+
         real_function_6d make_Rpsi(const ElectronPair& pair) const;
 
 		/// compute increments: psi^1 = C + GV C + GVGV C + GVGVGV C + ..
@@ -566,12 +589,19 @@ namespace madness {
         template<typename T, size_t NDIM>
         void load_function(Function<T,NDIM>& f, const std::string name) const;
 
+        /// the key of an intermediate of pair ij in the intermediate store
+        IntermediateKey intermediate_key(const std::string& name,
+        		const int i, const int j) const;
+
         /// return the function Uphi0; load from disk if available
         real_function_6d make_Uphi0(ElectronPair& pair) const;
 
         /// return the function [K,f] phi0; load from disk if available
         real_function_6d make_KffKphi0(const ElectronPair& pair) const;
 
+        /// set the orbital spaces of the strong orthogonality projector Q12
+        void set_orbital_spaces();
+
         /// compute some matrix elements that don't change during the SCF
         ElectronPair make_pair(const int i, const int j) const;
 
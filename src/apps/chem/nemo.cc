@@ -92,6 +92,13 @@ double Nemo::value(const Tensor<double>& x) {
 
 		// guess: multiply the guess orbitals with the inverse R
 		calc->amo = mul(world, R_inverse, calc->amo);
+
+		// better guess: the converged nemos of a previous run at this geometry
+		vecfuncT cached(calc->amo.size());
+		bool found = true;
+		for (std::size_t i = 0; found and i < cached.size(); ++i)
+			found = cache.load(cached[i], nemo_key(i));
+		if (found) calc->amo = cached;
 		calc->param.restart = true;
 	}
 
@@ -111,6 +118,8 @@ double Nemo::value(const Tensor<double>& x) {
 	}
 
 	if (calc->param.save) calc->save_mos(world);
+	for (std::size_t i = 0; i < calc->amo.size(); ++i)
+		cache.store(calc->amo[i], nemo_key(i));
 
 	// save the converged orbitals and nemos
 	vecfuncT psi = mul(world, R, calc->amo);
@@ -150,7 +159,7 @@ vecfuncT Nemo::localize(const vecfuncT& nemo) const {
 			calc->aocc, nemo.size());
 	// localize using the reconstructed orbitals
 	vecfuncT psi = mul(world, R, nemo);
-	dUT = calc->localize_PM(world, psi, aset, tolloc, 0.25, true, true);
+	dUT = calc->localize(world, psi, aset, tolloc, 0.25, true, true);
 	dUT.data().screen(trantol);
 
 	tensorT UT(calc->amo.size(),calc->amo.size());
@@ -470,6 +479,18 @@ void Nemo::rotate_subspace(World& world, const tensorT& U, solverT& solver,
 	}
 }
 
+/// the key of the converged nemo i in the intermediate store
+IntermediateKey Nemo::nemo_key(const int i) const {
+	std::ostringstream parameters;
+	parameters << "ncf " << int(nuclear_correlation->type())
+			<< " xc " << calc->param.xc_data
+			<< " nmo " << calc->amo.size()
+			<< " localize " << calc->param.localize;
+	return IntermediateKey("nemo_" + stringify(i), coords_sum,
+			FunctionDefaults<3>::get_thresh(), FunctionDefaults<3>::get_k(),
+			parameters.str());
+}
+
 /// save a function
 template<typename T, size_t NDIM>
 void Nemo::save_function(const Function<T,NDIM>& f, const std::string name) const {
@@ -52,6 +52,7 @@
 #include <madness/mra/lbdeux.h>
 #include <chem/SCF.h>
 #include <chem/correlationfactor.h>
+#include <chem/intermediatestore.h>
 #include <examples/nonlinsol.h>
 #include <madness/mra/vmra.h>
 
@@ -145,7 +146,7 @@ public:
 	/// @param[in]	world1	the world
 	/// @param[in]	calc	the SCF
 	Nemo(World& world1, std::shared_ptr<SCF> calc) :
-			world(world1), calc(calc), coords_sum(-1.0) {
+			world(world1), calc(calc), coords_sum(-1.0), cache(world1) {
 
 		// construct the Poisson solver
 		poisson = std::shared_ptr<real_convolution_3d>(
@@ -197,6 +198,12 @@ private:
 	/// a poisson solver
 	std::shared_ptr<real_convolution_3d> poisson;
 
+	/// converged nemos of previous runs
+	IntermediateStore cache;
+
+	/// the key of the converged nemo i in the intermediate store
+	IntermediateKey nemo_key(const int i) const;
+
 	void print_nuclear_corrfac() const;
 
 	/// solve the HF equations
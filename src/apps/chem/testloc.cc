@@ -0,0 +1,151 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+
+/// \file testloc.cc
+/// \brief Timings of the distributed Boys localization for many orbitals
+
+/// The dipole matrices are those of n orbitals centered on a chain of
+/// points, mixed by a random rotation.  Their localized form is diagonal,
+/// so the Boys functional sum_i |<i|r|i>|^2 must recover sum_k |r_k|^2.
+/// The cold start mixes all orbitals, the warm start only neighbours by
+/// small angles, where most pairs are skipped once converged.
+
+#include <madness/world/world.h>
+#include <madness/misc/ran.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/distributed_matrix.h>
+#include <chem/SCF.h>
+
+using namespace madness;
+
+/// Random orthogonal matrix as a product of random plane rotations
+
+/// If \c maxtheta is small only neighbours are mixed, giving nearly localized
+/// orbitals as in later SCF iterations, otherwise all orbitals are mixed
+static Tensor<double> random_rotation(int64_t n, double maxtheta) {
+    const bool local = (maxtheta < 1.0);
+    Tensor<double> Q(n,n);
+    for (int64_t i=0; i<n; ++i) Q(i,i) = 1.0;
+    for (int64_t k=0; k<8*n; ++k) {
+        int64_t i = int64_t(RandomValue<double>()*n) % n;
+        int64_t j = local ? i+1 : int64_t(RandomValue<double>()*n) % n;
+        if (i == j || j >= n) continue;
+        double theta = maxtheta*(2.0*RandomValue<double>() - 1.0);
+        double c = cos(theta), s = sin(theta);
+        for (int64_t l=0; l<n; ++l) {
+            double qi = Q(i,l), qj = Q(j,l);
+            Q(i,l) = c*qi - s*qj;
+            Q(j,l) = s*qi + c*qj;
+        }
+    }
+    return Q;
+}
+
+/// Localizes one set of n orbitals and checks the Boys functional
+static void run(World& world, int64_t n, bool warm, double thresh, bool& ok) {
+    // Centres on a slightly kinked chain
+    Tensor<double> r(n,3);
+    double exact = 0.0;
+    for (int64_t k=0; k<n; ++k) {
+        r(k,0) = 2.0*k;
+        r(k,1) = (k%2) ? 0.5 : -0.5;
+        r(k,2) = (k%3) * 0.25;
+        exact += r(k,0)*r(k,0) + r(k,1)*r(k,1) + r(k,2)*r(k,2);
+    }
+
+    // D = Q^T diag(r) Q, same on all processes
+    Tensor<double> Q(n,n);
+    if (world.rank() == 0) Q = random_rotation(n, warm ? 0.05 : constants::pi);
+    world.gop.broadcast(Q.ptr(), Q.size(), 0);
+
+    std::vector<Tensor<double> > D(3);
+    std::vector<DistributedMatrix<double> > dD;
+    for (int axis=0; axis<3; ++axis) {
+        Tensor<double> rQ = copy(Q);
+        for (int64_t k=0; k<n; ++k) rQ(k,_).scale(r(k,axis));
+        D[axis] = inner(Q, rQ, 0, 0);
+        dD.push_back(column_distributed_matrix<double>(world, n, n));
+        dD[axis].copy_from_replicated(D[axis]);
+    }
+    std::vector<int> set(n, 0);
+
+    world.gop.fence();
+    const double start = wall_time();
+    DistributedMatrix<double> dU =
+        distributed_localize_boys(world, dD[0], dD[1], dD[2], set, thresh, 0.5, false,
+                                  world.rank() == 0);
+    world.gop.fence();
+    const double used = wall_time() - start;
+
+    // Boys functional of the localized orbitals
+    Tensor<double> U(n,n);
+    dU.copy_to_replicated(U);
+    double sum = 0.0;
+    for (int axis=0; axis<3; ++axis) {
+        Tensor<double> DUT = inner(D[axis], U, 1, 1);
+        for (int64_t i=0; i<n; ++i) {
+            double dii = U(i,_).trace(DUT(_,i));
+            sum += dii*dii;
+        }
+    }
+    const double err = std::abs(sum - exact)/exact;
+    if (err > 0.1*thresh) ok = false;
+
+    if (world.rank() == 0)
+        printf("  thresh=%.0e  %s  n=%5ld  nproc=%4d  time=%9.3fs  functional=%.10e  exact=%.10e  relerr=%.1e\n",
+               thresh, warm ? "warm" : "cold", long(n), world.size(), used, sum, exact, err);
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    bool ok = true;
+    const int64_t sizes[] = {100, 200, 400};
+    const double threshes[] = {1e-3, 1e-9}; // the first as used in SCF
+    for (int ithresh=0; ithresh<2; ++ithresh) {
+        const double thresh = threshes[ithresh];
+        for (int warm=0; warm<2; ++warm) {
+            for (unsigned int isize=0; isize<sizeof(sizes)/sizeof(int64_t); ++isize) {
+                run(world, sizes[isize], warm, thresh, ok);
+            }
+        }
+    }
+
+    if (world.rank() == 0) print(ok ? "distributed Boys localization OK" : "distributed Boys localization FAILED");
+
+    world.gop.fence();
+    finalize();
+    return ok ? 0 : 1;
+}
@@ -5,6 +5,8 @@
 #include <chem/xcfunctional.h>
 #include <madness/tensor/tensor.h>
 #include <sstream>
+#include <vector>
+#include <cmath>
 #include <madness/world/world.h>
 
 namespace madness {
@@ -14,6 +16,7 @@ int x_rks_s__(const double *r__, double *f, double * dfdra);
 int c_rks_vwn5__(const double *r__, double *f, double * dfdra);
 int x_uks_s__(double *ra, double *rb, double *f, double *dfdra, double *dfdrb);
 int c_uks_vwn5__(double *ra, double *rb, double *f, double *dfdra, double *dfdrb);
+void xc_rks_s_vwn5_batch(const long n, const double *r__, double *f, double *dfdra);
 
 XCfunctional::XCfunctional() : hf_coeff(0.0) {
     rhotol=1e-7; rhomin=0.0; sigtol=1e-10; sigmin=1e-10; // default values
@@ -100,18 +103,17 @@ madness::Tensor<double> XCfunctional::exc(const std::vector< madness::Tensor<dou
             c_uks_vwn5__(&ra, &rb, &cf, cdfdr, cdfdr+1);
             
             f[i] = xf + cf;
-            if (isnan(f[i])) throw "numerical error in lda functional";
+            if (std::isnan(f[i])) throw "numerical error in lda functional";
         }
     }
     else {
         MADNESS_ASSERT(t.size() == 1);
-        double q1, q2, dq;
-        for (unsigned int i=0; i<result.size(); i++) {
-            double r = munge(2.0 * arho[i]); 
-            x_rks_s__(&r, &q1, &dq);
-            c_rks_vwn5__(&r, &q2, &dq);
-            f[i] = q1 + q2; 
-            if (isnan(f[i])) throw "numerical error in lda functional";
+        const long n = result.size();
+        std::vector<double> r(n), df(n);
+        for (long i=0; i<n; i++) r[i] = munge(2.0 * arho[i]);
+        xc_rks_s_vwn5_batch(n, &r[0], f, &df[0]);
+        for (long i=0; i<n; i++) {
+            if (std::isnan(f[i])) throw "numerical error in lda functional";
         }
     }
     return result;
@@ -136,19 +138,18 @@ madness::Tensor<double> XCfunctional::vxc(const std::vector< madness::Tensor<dou
             c_uks_vwn5__(&ra, &rb, &cf, cdfdr, cdfdr+1);
             
             f[i] = xdfdr[what] + cdfdr[what];
-            if (isnan(f[i])) throw "numerical error in lda functional";
+            if (std::isnan(f[i])) throw "numerical error in lda functional";
         }
     }
     else {
         MADNESS_ASSERT(t.size() == 1);
         const double* arho = t[0].ptr();
-        for (unsigned int i=0; i<result.size(); i++) {
-            double r = munge(2.0 * arho[i]); 
-            double q, dq1, dq2;
-            x_rks_s__(&r, &q, &dq1);
-            c_rks_vwn5__(&r, &q, &dq2); 
-            f[i] = dq1 + dq2;
-            if (isnan(f[i])) throw "numerical error in lda functional";
+        const long n = result.size();
+        std::vector<double> r(n), q(n);
+        for (long i=0; i<n; i++) r[i] = munge(2.0 * arho[i]);
+        xc_rks_s_vwn5_batch(n, &r[0], &q[0], f);
+        for (long i=0; i<n; i++) {
+            if (std::isnan(f[i])) throw "numerical error in lda functional";
         }
     }
     return result;
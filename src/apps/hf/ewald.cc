@@ -61,6 +61,19 @@ public:
         //return coeff*std::exp(-expnt*(x*x + y*y + z*z));
         return coeff*std::exp(-expnt*x*x)*std::exp(-expnt*y*y)*std::exp(-expnt*z*z);
     }
+
+    bool supports_grid() const {return true;}
+
+    void operator()(const Vector<const double*,3>& x, int npt, double* fvals) const {
+        std::vector<double> g(3*npt);
+        for (int d=0; d<3; ++d)
+            for (int i=0; i<npt; ++i) g[d*npt+i] = std::exp(-expnt*x[d][i]*x[d][i]);
+        for (int i=0; i<npt; ++i)
+            for (int j=0; j<npt; ++j) {
+                const double gxy = coeff*g[i]*g[npt+j];
+                for (int k=0; k<npt; ++k) *fvals++ = gxy*g[2*npt+k];
+            }
+    }
 };
 //*************************************************************************
 void gen_ce(double mu, double xlo, double eps, Tensor<double>& c, Tensor<double>& e)
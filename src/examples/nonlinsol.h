@@ -49,6 +49,10 @@
 
 #include <madness/mra/mra.h>
 #include <madness/tensor/solvers.h>
+#include <madness/world/parar.h>
+#include <deque>
+#include <string>
+#include <unistd.h>
 
 namespace madness {
 
@@ -153,7 +157,211 @@ namespace madness {
 	struct default_allocator {
         T operator()() {return T();}
     };
-    
+
+
+    /// Keeps the subspace of previous solutions and residuals in memory
+
+    /// \ingroup nonlinearsolve
+    template <class T>
+    class InCoreSubspace {
+        std::vector<T> ulist, rlist;
+    public:
+        std::size_t size() const {return ulist.size();}
+
+        const T& u(std::size_t i) const {return ulist[i];}
+        const T& r(std::size_t i) const {return rlist[i];}
+
+        void push_back(const T& u, const T& r) {
+            ulist.push_back(u);
+            rlist.push_back(r);
+        }
+
+        void set(std::size_t i, const T& u, const T& r) {
+            ulist[i] = u;
+            rlist[i] = r;
+        }
+
+        void pop_front() {
+            ulist.erase(ulist.begin());
+            rlist.erase(rlist.begin());
+        }
+
+        void clear() {
+            ulist.clear();
+            rlist.clear();
+        }
+
+        std::vector<T>& get_ulist() {return ulist;}
+        std::vector<T>& get_rlist() {return rlist;}
+    };
+
+
+    /// Writes a subspace vector to a parallel archive in compressed form
+    template <typename T, std::size_t NDIM>
+    void subspace_store(const archive::ParallelOutputArchive& ar, const Function<T,NDIM>& f) {
+        f.compress();
+        ar & f;
+    }
+
+    template <typename T, std::size_t NDIM>
+    void subspace_store(const archive::ParallelOutputArchive& ar, const std::vector<Function<T,NDIM> >& v) {
+        compress(*ar.get_world(), v);
+        ar & v.size();
+        for (unsigned int i=0; i<v.size(); ++i) ar & v[i];
+    }
+
+    /// Reads a subspace vector written by subspace_store
+    template <typename T, std::size_t NDIM>
+    void subspace_load(const archive::ParallelInputArchive& ar, Function<T,NDIM>& f) {
+        ar & f;
+    }
+
+    template <typename T, std::size_t NDIM>
+    void subspace_load(const archive::ParallelInputArchive& ar, std::vector<Function<T,NDIM> >& v) {
+        std::size_t n;
+        ar & n;
+        v.resize(n);
+        for (unsigned int i=0; i<n; ++i) ar & v[i];
+    }
+
+
+    /// Keeps the subspace of previous solutions and residuals on disk
+
+    /// \ingroup nonlinearsolve
+    ///
+    /// Each entry of the subspace is written in compressed form to its own
+    /// parallel archive as soon as it is added, and only the entry last
+    /// accessed is kept in memory, so the solver streams through the
+    /// subspace when it forms the subspace matrix and the update.  The
+    /// archives use one writer per process (up to the limit of the archive
+    /// layer), so with a node-local directory the data stays on the node.
+    ///
+    /// \c T must have overloads of subspace_store() and subspace_load(),
+    /// which exist for functions and vectors of functions.  Without a world
+    /// or with an empty directory name the subspace is kept in memory.
+    /// A copy starts with an empty subspace of its own.
+    template <class T>
+    class OutOfCoreSubspace {
+        World* world;
+        std::string dir;
+        std::string prefix;         ///< File name prefix unique to this subspace
+        std::deque<long> ids;       ///< Entries on disk, oldest first
+        long next_id;
+        InCoreSubspace<T> incore;   ///< Used if not on disk
+
+        mutable long cached_id;     ///< The entry in memory, or -1
+        mutable T cached_u, cached_r;
+
+        void make_prefix() {
+            static long ninstance = 0;
+            long pid = getpid();
+            world->gop.broadcast(pid, 0);
+            prefix = dir + "/kain." + stringify(pid) + "." + stringify(ninstance++);
+        }
+
+        std::string filename(long id) const {return prefix + "." + stringify(id);}
+
+        void write(long id, const T& u, const T& r) const {
+            archive::ParallelOutputArchive ar(*world, filename(id).c_str(), world->size());
+            subspace_store(ar, u);
+            subspace_store(ar, r);
+        }
+
+        /// Each process removes its own file, so that node-local disks work
+
+        /// Reading an archive is collective, so no process still needs the file
+        void remove(long id) const {
+            char buf[256];
+            sprintf(buf, "%s.%5.5d", filename(id).c_str(), world->rank());
+            ::remove(buf);
+        }
+
+        void cache(long id) const {
+            if (id == cached_id) return;
+            archive::ParallelInputArchive ar(*world, filename(id).c_str(), world->size());
+            subspace_load(ar, cached_u);
+            subspace_load(ar, cached_r);
+            cached_id = id;
+        }
+
+        void uncache() const {
+            cached_id = -1;
+            cached_u = T();
+            cached_r = T();
+        }
+
+    public:
+        OutOfCoreSubspace() : world(0), next_id(0), cached_id(-1) {}
+
+        /// Constructor
+
+        /// @param[in] world The world
+        /// @param[in] dir Directory for the subspace files, empty to keep the subspace in memory
+        OutOfCoreSubspace(World& world, const std::string& dir)
+            : world(&world), dir(dir), next_id(0), cached_id(-1) {
+            if (on_disk()) make_prefix();
+        }
+
+        OutOfCoreSubspace(const OutOfCoreSubspace& other)
+            : world(other.world), dir(other.dir), next_id(0), cached_id(-1) {
+            if (on_disk()) make_prefix();
+        }
+
+        ~OutOfCoreSubspace() {clear();}
+
+        bool on_disk() const {return world and not dir.empty();}
+
+        std::size_t size() const {return on_disk() ? ids.size() : incore.size();}
+
+        /// The solution of entry i, valid until another entry is accessed
+        const T& u(std::size_t i) const {
+            if (not on_disk()) return incore.u(i);
+            cache(ids[i]);
+            return cached_u;
+        }
+
+        /// The residual of entry i, valid until another entry is accessed
+        const T& r(std::size_t i) const {
+            if (not on_disk()) return incore.r(i);
+            cache(ids[i]);
+            return cached_r;
+        }
+
+        void push_back(const T& u, const T& r) {
+            if (not on_disk()) return incore.push_back(u, r);
+            write(next_id, u, r);
+            ids.push_back(next_id);
+            cached_id = next_id++;
+            cached_u = u;
+            cached_r = r;
+        }
+
+        void set(std::size_t i, const T& u, const T& r) {
+            if (not on_disk()) return incore.set(i, u, r);
+            remove(ids[i]);
+            write(ids[i], u, r);
+            cached_id = ids[i];
+            cached_u = u;
+            cached_r = r;
+        }
+
+        void pop_front() {
+            if (not on_disk()) return incore.pop_front();
+            if (cached_id == ids.front()) uncache();
+            remove(ids.front());
+            ids.pop_front();
+        }
+
+        void clear() {
+            if (not on_disk()) return incore.clear();
+            uncache();
+            while (not ids.empty()) {
+                remove(ids.front());
+                ids.pop_front();
+            }
+        }
+    };
+
     /// Generalized version of NonlinearSolver not limited to a single madness function
 
     /// \ingroup nonlinearsolve 
@@ -170,30 +378,40 @@ namespace madness {
     ///
     /// I've not yet tested with anything except \c C=double and I think
     /// that the KAIN routine will need extending for anything else.
-    template <class T, class C = double, class Alloc = default_allocator<T> >
+    ///
+    /// The subspace is kept in memory by default.  With \c Subspace set to
+    /// OutOfCoreSubspace<T> it is kept on disk, and the solver holds only
+    /// the subspace matrix and one previous iterate at a time.
+    template <class T, class C = double, class Alloc = default_allocator<T>,
+              class Subspace = InCoreSubspace<T> >
     class XNonlinearSolver {
         unsigned int maxsub; ///< Maximum size of subspace dimension
         Alloc alloc;
-        std::vector<T> ulist, rlist; ///< Subspace information
+        Subspace subspace; ///< Subspace information
         Tensor<C> Q;
     public:
         bool do_print;
 
-	XNonlinearSolver(const Alloc& alloc = Alloc())
+	XNonlinearSolver(const Alloc& alloc = Alloc(), const Subspace& subspace = Subspace())
             : maxsub(10)
             , alloc(alloc)
+            , subspace(subspace)
     		, do_print(false)
         {}
 
 	XNonlinearSolver(const XNonlinearSolver& other)
             : maxsub(other.maxsub)
             , alloc(other.alloc)
+            , subspace(other.subspace)
 			, do_print(false)
-        {}
+        {
+            subspace.clear();
+        }
 
 
-	std::vector<T>& get_ulist() {return ulist;}
-	std::vector<T>& get_rlist() {return rlist;}
+	/// Only for the in-memory subspace
+	std::vector<T>& get_ulist() {return subspace.get_ulist();}
+	std::vector<T>& get_rlist() {return subspace.get_rlist();}
 
 	void set_maxsub(int maxsub) {this->maxsub = maxsub;}
 
@@ -209,16 +427,15 @@ namespace madness {
         /// @param[in]          cabsmax  maximum element of c greater than this will cause the subspace to be shrunk due to li
 	T update(const T& u, const T& r, const double rcondtol=1e-8, const double cabsmax=1000.0) {
 		if (maxsub==1) return u-r;
-		int iter = ulist.size();
-		ulist.push_back(u);
-		rlist.push_back(r);
+		int iter = subspace.size();
+		subspace.push_back(u,r);
 
 		// Solve subspace equations
 		Tensor<C> Qnew(iter+1,iter+1);
 		if (iter>0) Qnew(Slice(0,-2),Slice(0,-2)) = Q;
 		for (int i=0; i<=iter; i++) {
-			Qnew(i,iter) = inner(ulist[i],rlist[iter]);
-			Qnew(iter,i) = inner(ulist[iter],rlist[i]);
+			Qnew(i,iter) = inner(subspace.u(i),r);
+			Qnew(iter,i) = inner(u,subspace.r(i));
 		}
 		Q = Qnew;
 		Tensor<C> c = KAIN(Q);
@@ -229,12 +446,11 @@ namespace madness {
 		// Form new solution in u
 		T unew = alloc();
 		for (int i=0; i<=iter; i++) {
-			unew += (ulist[i] - rlist[i])*c[i];
+			unew += (subspace.u(i) - subspace.r(i))*c[i];
 		}
 
-		if (ulist.size() == maxsub) {
-			ulist.erase(ulist.begin());
-			rlist.erase(rlist.begin());
+		if (subspace.size() == maxsub) {
+			subspace.pop_front();
 			Q = copy(Q(Slice(1,-1),Slice(1,-1)));
 		}
 		return unew;
@@ -39,18 +39,22 @@
 /// \brief Provides FunctionCommonData, FunctionImpl and FunctionFactory
 
 #include <iostream>
+#include <limits>
 #include <madness/world/world.h>
 #include <madness/world/print.h>
 #include <madness/world/scopedptr.h>
 #include <madness/misc/misc.h>
 #include <madness/tensor/tensor.h>
 #include <madness/tensor/gentensor.h>
+#include <madness/tensor/cblas.h>
 
 #include <madness/mra/function_common_data.h>
 #include <madness/mra/indexit.h>
 #include <madness/mra/key.h>
 #include <madness/mra/funcdefaults.h>
 #include <madness/mra/function_factory.h>
+#include <madness/mra/lbdeux.h>
+#include <madness/mra/supportindex.h>
 
 namespace madness {
     template <typename T, std::size_t NDIM>
@@ -108,6 +112,9 @@ namespace madness {
 
         LevelPmap(World& world) : nproc(world.nproc()) {}
 
+        /// Map for a given number of processes, e.g.\ to analyze the distribution
+        explicit LevelPmap(int nproc) : nproc(nproc) {}
+
         /// Find the owner of a given key
         ProcessID owner(const keyT& key) const {
             Level n = key.level();
@@ -126,6 +133,15 @@ namespace madness {
     public:
     	typedef GenTensor<T> coeffT;
     	typedef Tensor<T> tensorT;
+        typedef Tensor<typename TensorTypeData<T>::low_precision_type> lowtensorT;
+
+        /// Flags marking a node as modified since the last norm_tree, truncate or redundant pass
+
+        /// Every mutating member function sets all flags, the incremental
+        /// passes in FunctionImpl revisit only nodes with their flag set and
+        /// clear it after recomputing the node.  The flags are conservative:
+        /// any non-const access to the coefficients counts as a modification.
+        enum DirtyFlags {DIRTY_NORM_TREE=1, DIRTY_TRUNCATE=2, DIRTY_REDUNDANT=4, DIRTY_ALL=7};
     private:
         // Should compile OK with these volatile but there should
         // be no need to set as volatile since the container internally
@@ -135,12 +151,14 @@ namespace madness {
         double _norm_tree; ///< After norm_tree will contain norm of coefficients summed up tree
         bool _has_children; ///< True if there are children
         coeffT buffer; ///< The coefficients, if any
+        lowtensorT _lowcoeffs; ///< The coefficients in reduced precision, see compact()
+        unsigned char _dirty; ///< DirtyFlags of the passes that must revisit this node
 
     public:
         typedef WorldContainer<Key<NDIM> , FunctionNode<T, NDIM> > dcT; ///< Type of container holding the nodes
         /// Default constructor makes node without coeff or children
         FunctionNode() :
-            _coeffs(), _norm_tree(1e300), _has_children(false) {
+            _coeffs(), _norm_tree(1e300), _has_children(false), _dirty(DIRTY_ALL) {
         }
 
         /// Constructor from given coefficients with optional children
@@ -150,12 +168,12 @@ namespace madness {
         /// take ownership.
         explicit
         FunctionNode(const coeffT& coeff, bool has_children = false) :
-            _coeffs(coeff), _norm_tree(1e300), _has_children(has_children) {
+            _coeffs(coeff), _norm_tree(1e300), _has_children(has_children), _dirty(DIRTY_ALL) {
         }
 
         explicit
         FunctionNode(const coeffT& coeff, double norm_tree, bool has_children) :
-            _coeffs(coeff), _norm_tree(norm_tree), _has_children(has_children) {
+            _coeffs(coeff), _norm_tree(norm_tree), _has_children(has_children), _dirty(DIRTY_ALL) {
         }
 
         FunctionNode(const FunctionNode<T, NDIM>& other) {
@@ -166,8 +184,10 @@ namespace madness {
         operator=(const FunctionNode<T, NDIM>& other) {
             if (this != &other) {
                 coeff() = copy(other.coeff());
+                _lowcoeffs = copy(other._lowcoeffs);
                 _norm_tree = other._norm_tree;
                 _has_children = other._has_children;
+                _dirty = other._dirty;
             }
             return *this;
         }
@@ -179,7 +199,7 @@ namespace madness {
         template<typename Q>
         FunctionNode<Q, NDIM>
         convert() const {
-            return FunctionNode<Q, NDIM> (copy(coeff()), _has_children);
+            return FunctionNode<Q, NDIM> (copy(full_precision_coeff()), _has_children);
         }
 
         /// Returns true if there are coefficients in this node
@@ -212,6 +232,7 @@ namespace madness {
         /// Returns an empty tensor if there are no coefficients.
         coeffT&
         coeff() {
+            _dirty = DIRTY_ALL;
             MADNESS_ASSERT(_coeffs.ndim() == -1 || (_coeffs.dim(0) <= 2
                                                     * MAXK && _coeffs.dim(0) >= 0));
             return const_cast<coeffT&>(_coeffs);
@@ -230,10 +251,58 @@ namespace madness {
             return _coeffs.size();
         }
 
+        /// Returns true if the coefficients are stored in reduced precision
+        bool is_compact() const {
+            return _lowcoeffs.has_data();
+        }
+
+        /// Returns the coefficients in full precision, promoting compact storage on the fly
+
+        /// Shallow copy of the coefficients if not compact, otherwise a new tensor
+        coeffT full_precision_coeff() const {
+            if (is_compact()) return coeffT(tensorT(_lowcoeffs),-1.0,TT_FULL);
+            return _coeffs;
+        }
+
+        /// Store the coefficients in reduced precision if the rounding error is below tol
+
+        /// Only full rank coefficients are stored in reduced precision; the
+        /// rounding error is bounded by the machine precision of the storage
+        /// type times the norm of the coefficients.
+        /// @param[in]  tol the admissible error for this node
+        /// @return     true if the coefficients are now stored in reduced precision
+        bool compact(const double tol) {
+            typedef typename lowtensorT::type lowT;
+            if (not has_coeff() or (_coeffs.tensor_type()!=TT_FULL)) return false;
+            const double eps=std::numeric_limits<typename TensorTypeData<lowT>::scalar_type>::epsilon();
+            if (_coeffs.normf()*eps>tol) return false;
+            _lowcoeffs=lowtensorT(_coeffs.full_tensor());
+            _coeffs=coeffT();
+            _dirty=DIRTY_ALL;
+            return true;
+        }
+
+        /// Restore the coefficients in full precision after compact()
+        void expand() {
+            if (not is_compact()) return;
+            _coeffs=coeffT(tensorT(_lowcoeffs),-1.0,TT_FULL);
+            _lowcoeffs=lowtensorT();
+            _dirty=DIRTY_ALL;
+        }
+
+        /// Returns the memory used by the coefficients in bytes
+        size_t real_size() const {
+            size_t sum=0;
+            if (has_coeff()) sum+=_coeffs.real_size();
+            if (is_compact()) sum+=_lowcoeffs.size()*sizeof(typename lowtensorT::type);
+            return sum;
+        }
+
     public:
 
         /// reduces the rank of the coefficients (if applicable)
         void reduceRank(const double& eps) {
+            _dirty = DIRTY_ALL;
             _coeffs.reduce_rank(eps);
         }
 
@@ -241,6 +310,7 @@ namespace madness {
         Void
         set_has_children(bool flag) {
             _has_children = flag;
+            _dirty = DIRTY_ALL;
             return None;
         }
 
@@ -263,12 +333,14 @@ namespace madness {
                 //madness::print("   set_chi_recu: forwarding",key,parent);
             }
             _has_children = true;
+            _dirty = DIRTY_ALL;
             return None;
         }
 
         /// Sets \c has_children attribute to value of \c !flag
         void set_is_leaf(bool flag) {
             _has_children = !flag;
+            _dirty = DIRTY_ALL;
         }
 
         /// Takes a \em shallow copy of the coeff --- same as \c this->coeff()=coeff
@@ -289,12 +361,14 @@ namespace madness {
         /// Scale the coefficients of this node
         template <typename Q>
         void scale(Q a) {
+            _dirty = DIRTY_ALL;
             _coeffs.scale(a);
         }
 
         /// Sets the value of norm_tree
         Void set_norm_tree(double norm_tree) {
             _norm_tree = norm_tree;
+            _dirty |= DIRTY_NORM_TREE;
             return None;
         }
 
@@ -303,6 +377,38 @@ namespace madness {
             return _norm_tree;
         }
 
+        /// Sets the value of norm_tree computed by a norm_tree pass and marks it as current
+        Void update_norm_tree(double norm_tree) {
+            _norm_tree = norm_tree;
+            _dirty &= ~DIRTY_NORM_TREE;
+            return None;
+        }
+
+        /// Returns true if any of the given DirtyFlags is set
+        bool is_dirty(unsigned char flags=DIRTY_ALL) const {
+            return (_dirty & flags) != 0;
+        }
+
+        /// Clears the given DirtyFlags after the node has been recomputed
+        void clear_dirty(unsigned char flags=DIRTY_ALL) {
+            _dirty &= ~flags;
+        }
+
+        /// Sets the given DirtyFlags recurring up so the path to the root is revisited
+
+        /// Stops at the first ancestor that already has all flags set, since
+        /// its own path has been marked before.
+        Void set_dirty_recursive(const typename FunctionNode<T,NDIM>::dcT& c, const Key<NDIM>& key,
+                                 unsigned char flags) {
+            if ((_dirty & flags) == flags) return None;
+            _dirty |= flags;
+            if (key.level() > 0) {
+                Key<NDIM> parent = key.parent();
+                const_cast<dcT&>(c).task(parent, &FunctionNode<T,NDIM>::set_dirty_recursive, c, parent, flags);
+            }
+            return None;
+        }
+
 
         /// General bi-linear operation --- this = this*alpha + other*beta
 
@@ -311,6 +417,7 @@ namespace madness {
         template <typename Q, typename R>
         Void gaxpy_inplace(const T& alpha, const FunctionNode<Q,NDIM>& other, const R& beta) {
             //PROFILE_MEMBER_FUNC(FuncNode);  // Too fine grain for routine profiling
+            _dirty = DIRTY_ALL;
             if (other.has_children())
                 _has_children = true;
             if (has_coeff()) {
@@ -331,6 +438,7 @@ namespace madness {
         double accumulate2(const tensorT& t, const typename FunctionNode<T,NDIM>::dcT& c,
                            const Key<NDIM>& key) {
             double cpu0=cpu_time();
+            _dirty = DIRTY_ALL;
             if (has_coeff()) {
             	MADNESS_ASSERT(coeff().tensor_type()==TT_FULL);
                 //            	if (coeff().type==TT_FULL) {
@@ -362,25 +470,25 @@ namespace madness {
         double accumulate(const coeffT& t, const typename FunctionNode<T,NDIM>::dcT& c,
                           const Key<NDIM>& key, const TensorArgs& args) {
             double cpu0=cpu_time();
+            _dirty = DIRTY_ALL;
             if (has_coeff()) {
 
-#if 1
-                coeff().add_SVD(t,args.thresh);
-                if (buffer.rank()<coeff().rank()) {
+                if ((t.tensor_type()==TT_2D) and (coeff().tensor_type()==TT_2D)) {
+                    // defer the rank reduction: collect the unreduced terms in the
+                    // buffer and recompress them all at once in consolidate_buffer;
+                    // only if the buffer grows too large do an intermediate reduction
                     if (buffer.has_data()) {
-                        buffer.add_SVD(coeff(),args.thresh);
+                        t.append(buffer);
                     } else {
-                        buffer=copy(coeff());
+                        buffer=copy(t);
+                    }
+                    if (buffer.rank()>max_deferred_rank(coeff().rank())) {
+                        buffer.randomized_reduce_rank(args.thresh);
                     }
-                    coeff()=coeffT();
+                } else {
+                    coeff().add_SVD(t,args.thresh);
                 }
 
-#else
-                // always do low rank
-                coeff().add_SVD(t,args.thresh);
-
-#endif
-
             } else {
                 // No coeff and no children means the node is newly
                 // created for this operation and therefore we must
@@ -395,7 +503,15 @@ namespace madness {
             return cpu1-cpu0;
         }
 
+        /// the rank of the deferred accumulation buffer that triggers an intermediate reduction
+
+        /// @param[in]  rank    the rank of the node's coefficients
+        static long max_deferred_rank(const long rank) {
+            return std::max(100L,4*rank);
+        }
+
         Void consolidate_buffer(const TensorArgs& args) {
+            buffer.randomized_reduce_rank(args.thresh);
             if ((coeff().has_data()) and (buffer.has_data())) {
                 coeff().add_SVD(buffer,args.thresh);
             } else if (buffer.has_data()) {
@@ -411,7 +527,8 @@ namespace madness {
 
         template <typename Archive>
         void serialize(Archive& ar) {
-            ar & coeff() & _has_children & _norm_tree;
+            ar & _coeffs & _has_children & _norm_tree & _lowcoeffs;
+            if (Archive::is_input_archive) _dirty = DIRTY_ALL;
         }
 
     };
@@ -950,6 +1067,22 @@ namespace madness {
         AtomicInt small;
         AtomicInt large;
 
+        /// partial apply results for one destination node, combined before sending
+        struct apply_buffer_entry {
+            coeffT coeff;       ///< sum of the contributions so far
+            int count;          ///< number of contributions in coeff
+            TensorArgs args;    ///< accumulation args, tightest threshold seen
+            apply_buffer_entry() : coeff(), count(0), args() {}
+        };
+        typedef ConcurrentHashMap<keyT,apply_buffer_entry> apply_bufferT;
+
+        /// per-destination buffer of apply results, flushed by flush_apply_buffer
+        apply_bufferT apply_buffer;
+        AtomicInt apply_buffer_nresult;    ///< number of results put into the buffer
+        AtomicInt apply_buffer_nsend;      ///< number of accumulate tasks sent from the buffer
+        AtomicInt nodes_touched;           ///< number of nodes recomputed by tree passes, see get_nodes_touched
+        double last_truncate_tol;          ///< tolerance of the last truncation in compressed form
+
         /// Initialize function impl from data in factory
         FunctionImpl(const FunctionFactory<T,NDIM>& factory)
             : WorldObject<implT>(factory._world)
@@ -999,6 +1132,11 @@ namespace madness {
                 insert_zero_down_to_initial_level(keyT(0));
             }
 
+            apply_buffer_nresult=0;
+            apply_buffer_nsend=0;
+            nodes_touched=0;
+            last_truncate_tol=-1.0;
+
             coeffs.process_pending();
             this->process_pending();
             if (factory._fence && functor)
@@ -1038,6 +1176,10 @@ namespace madness {
                 initial_level = 1;
                 insert_zero_down_to_initial_level(cdata.key0);
             }
+            apply_buffer_nresult=0;
+            apply_buffer_nsend=0;
+            nodes_touched=0;
+            last_truncate_tol=-1.0;
             coeffs.process_pending();
             this->process_pending();
         }
@@ -1224,11 +1366,17 @@ namespace madness {
         /// If thresh<=0 the default value of this->thresh is used
         void truncate(double tol, bool fence);
 
+        /// Truncate only the subtrees modified since the last truncation of the compressed tree
+
+        /// Falls back to truncate() if the function is not compressed or was
+        /// last truncated with a different tolerance.
+        void truncate_incremental(double tol, bool fence);
+
         /// Returns true if after truncation this node has coefficients
 
         /// Assumed to be invoked on process owning key.  Possible non-blocking
-        /// communication.
-        Future<bool> truncate_spawn(const keyT& key, double tol);
+        /// communication.  If incremental, clean subtrees are not revisited.
+        Future<bool> truncate_spawn(const keyT& key, double tol, bool incremental);
 
         /// Actually do the truncate operation
         bool truncate_op(const keyT& key, double tol, const std::vector< Future<bool> >& v);
@@ -2207,6 +2355,35 @@ namespace madness {
             template <typename Archive> void serialize(const Archive& ar) {}
         };
 
+        /// store the nodes' coeffs in reduced precision where the truncation threshold allows
+        struct do_compact {
+            typedef Range<typename dcT::iterator> rangeT;
+
+            const implT* f;
+
+            do_compact() {}
+            do_compact(const implT* f) : f(f) {}
+
+            bool operator()(typename rangeT::iterator& it) const {
+                const keyT& key = it->first;
+                nodeT& node = it->second;
+                node.compact(0.1*f->truncate_tol(f->get_thresh(),key));
+                return true;
+            }
+            template <typename Archive> void serialize(const Archive& ar) {}
+        };
+
+        /// restore the nodes' coeffs in full precision
+        struct do_expand {
+            typedef Range<typename dcT::iterator> rangeT;
+
+            bool operator()(typename rangeT::iterator& it) const {
+                it->second.expand();
+                return true;
+            }
+            template <typename Archive> void serialize(const Archive& ar) {}
+        };
+
         struct do_consolidate_buffer {
             typedef Range<typename dcT::iterator> rangeT;
 
@@ -2252,45 +2429,85 @@ namespace madness {
             template <typename Archive> void serialize(const Archive& ar) {}
         };
 
+        /// Transforms all coefficients of a range of keys at once
+
+        /// All coefficients of the right functions on a key are collected into
+        /// one matrix, and the coefficients of all left functions on that key
+        /// are computed by a single matrix product. Each left node is then
+        /// touched only once.  Left functions whose coefficients for all
+        /// right functions on the key are zero are left out of the product,
+        /// so sparse (screened) transformations are cheap.  Low-rank
+        /// coefficients fall back to the term-by-term accumulation.
+        /// @param[in]  rstart  first entry of the key map of the right functions
+        /// @param[in]  rend    end of the range of entries
+        /// @param[in]  rmap    the key map of the right functions (keeps the range alive)
+        /// @param[in]  c       the transformation matrix c(j,i)
+        /// @param[in]  vleft   the left functions
+        /// @param[in]  tol     screening threshold
         template <typename Q, typename R>
-        Void vtransform_doit(const std::shared_ptr< FunctionImpl<R,NDIM> >& right,
+        Void vtransform_doit(const typename FunctionImpl<R,NDIM>::mapT::iterator rstart,
+                             const typename FunctionImpl<R,NDIM>::mapT::iterator rend,
+                             const std::shared_ptr<typename FunctionImpl<R,NDIM>::mapT>& rmap,
                              const Tensor<Q>& c,
                              const std::vector< std::shared_ptr< FunctionImpl<T,NDIM> > >& vleft,
                              double tol) {
-            // To reduce crunch on vectors being transformed each task
-            // does them in a random order
-            std::vector<unsigned int> ind(vleft.size());
-            for (unsigned int i=0; i<vleft.size(); ++i) {
-                ind[i] = i;
-            }
-            for (unsigned int i=0; i<vleft.size(); ++i) {
-                unsigned int j = RandomValue<int>()%vleft.size();
-                std::swap(ind[i],ind[j]);
-            }
+            const long nleft=vleft.size();
+            for (typename FunctionImpl<R,NDIM>::mapT::iterator rit=rstart; rit!=rend; ++rit) {
+                const keyT& key = rit->first;
+                const typename FunctionImpl<R,NDIM>::mapvecT& rightv = rit->second;
+                const long nright=rightv.size();
+                const double keytol = truncate_tol(tol,key);
+
+                // check if all coefficients are full rank and of the same size
+                bool full=true;
+                const long size=rightv[0].second->size();
+                for (long jv=0; jv<nright; ++jv) {
+                    const GenTensor<R>* r=rightv[jv].second;
+                    full=full and (r->tensor_type()==TT_FULL) and (r->size()==size);
+                }
 
-            typename FunctionImpl<R,NDIM>::dcT::const_iterator end = right->coeffs.end();
-            for (typename FunctionImpl<R,NDIM>::dcT::const_iterator it=right->coeffs.begin(); it != end; ++it) {
-                if (it->second.has_coeff()) {
-                    const Key<NDIM>& key = it->first;
-                    const GenTensor<R>& r = it->second.coeff();
-                    double norm = r.normf();
-                    double keytol = truncate_tol(tol,key);
-
-                    for (unsigned int j=0; j<vleft.size(); ++j) {
-                        unsigned int i = ind[j]; // Random permutation
-                        if (std::abs(norm*c(i)) > keytol) {
-                            implT* left = vleft[i].get();
-                            typename dcT::accessor acc;
-                            bool newnode = left->coeffs.insert(acc,key);
-                            if (newnode && key.level()>0) {
-                                Key<NDIM> parent = key.parent();
-                                left->coeffs.task(parent, &nodeT::set_has_children_recursive, left->coeffs, parent);
+                if (full) {
+                    // only the left functions with a nonzero coefficient
+                    // for one of the right functions on this key take part
+                    std::vector<long> active;
+                    for (long i=0; i<nleft; ++i) {
+                        for (long jv=0; jv<nright; ++jv) {
+                            if (c(rightv[jv].first,i) != Q(0.0)) {
+                                active.push_back(i);
+                                break;
+                            }
+                        }
+                    }
+                    if (active.size()==0) continue;
+                    const long nactive=active.size();
+
+                    Tensor<R> rr(nright,size);
+                    Tensor<Q> cc(nright,nactive);
+                    for (long jv=0; jv<nright; ++jv) {
+                        const int j=rightv[jv].first;
+                        rr(jv,_)=rightv[jv].second->full_tensor().flat();
+                        for (long ia=0; ia<nactive; ++ia) cc(jv,ia)=c(j,active[ia]);
+                    }
+                    const tensorT result=inner(cc,rr,0,0);
+                    const Tensor<R> r0=rightv[0].second->full_tensor();
+
+                    for (long ia=0; ia<nactive; ++ia) {
+                        tensorT ri=result(ia,_);
+                        if (ri.normf()<=keytol) continue;
+                        ri=copy(ri).reshape(r0.ndim(),r0.dims());
+                        nodeT& node=vtransform_node(vleft[active[ia]].get(),key);
+                        node.coeff().gaxpy(1.0,coeffT(ri,-1.0,TT_FULL),1.0);
+                    }
+                } else {
+                    for (long jv=0; jv<nright; ++jv) {
+                        const int j=rightv[jv].first;
+                        const GenTensor<R>& r=*(rightv[jv].second);
+                        const double norm=r.normf();
+                        for (long i=0; i<nleft; ++i) {
+                            if (std::abs(norm*c(j,i)) > keytol) {
+                                nodeT& node=vtransform_node(vleft[i].get(),key);
+                                node.coeff().gaxpy(1.0, r, c(j,i));
                             }
-                            nodeT& node = acc->second;
-                            if (!node.has_coeff())
-                                node.set_coeff(coeffT(cdata.v2k,targs));
-                            coeffT& t = node.coeff();
-                            t.gaxpy(1.0, r, c(i));
                         }
                     }
                 }
@@ -2298,6 +2515,22 @@ namespace madness {
             return None;
         }
 
+        /// return the node of left on key for accumulating the result of vtransform
+
+        /// a new node gets zero coefficients and its parents are marked as having children
+        static nodeT& vtransform_node(implT* left, const keyT& key) {
+            typename dcT::accessor acc;
+            bool newnode = left->coeffs.insert(acc,key);
+            if (newnode && key.level()>0) {
+                Key<NDIM> parent = key.parent();
+                left->coeffs.task(parent, &nodeT::set_has_children_recursive, left->coeffs, parent);
+            }
+            nodeT& node = acc->second;
+            if (!node.has_coeff())
+                node.set_coeff(coeffT(left->cdata.v2k,left->targs));
+            return node;
+        }
+
         /// Refine multiple functions down to the same finest level
 
         /// @param v is the vector of functions we are refining.
@@ -2332,6 +2565,57 @@ namespace madness {
             world.gop.fence();
         }
 
+        /// Apply a pointwise op to the values of a batch of boxes with one call
+
+        /// The values of the boxes are stacked along the first dimension,
+        /// so op sees one contiguous tensor of dimensions (nbox*k,k,...,k)
+        /// per function, and is passed the key of the first box.
+        template <typename opT>
+        Void multiop_values_batch_doit(const std::vector<keyT>& keys, const opT& op, const std::vector<implT*>& v) {
+            long npt = 1;
+            for (std::size_t d=0; d<NDIM; ++d) npt *= cdata.k;
+            std::vector<long> dims(NDIM,cdata.k);
+            dims[0] *= keys.size();
+            std::vector<tensorT> c(v.size());
+            for (unsigned int i=0; i<v.size(); i++) {
+                c[i] = tensorT(dims,false);
+                for (std::size_t b=0; b<keys.size(); ++b) {
+                    const tensorT values = coeffs2values(keys[b], v[i]->coeffs.find(keys[b]).get()->second.coeff().full_tensor_copy());
+                    std::memcpy(c[i].ptr()+b*npt, values.ptr(), npt*sizeof(T));
+                }
+            }
+            const tensorT r = op(keys[0], c);
+            MADNESS_ASSERT(r.size() == long(keys.size())*npt);
+            for (std::size_t b=0; b<keys.size(); ++b) {
+                tensorT values(cdata.vk,false);
+                std::memcpy(values.ptr(), r.ptr()+b*npt, npt*sizeof(T));
+                coeffs.replace(keys[b], nodeT(coeffT(values2coeffs(keys[b], values),targs),false));
+            }
+            return None;
+        }
+
+        // assumes all functions have been refined down to the same level
+        template <typename opT>
+        void multiop_values_batched(const opT& op, const std::vector<implT*>& v, const std::size_t nbatch) {
+            std::vector<keyT> keys;
+            typename dcT::iterator end = v[0]->coeffs.end();
+            for (typename dcT::iterator it=v[0]->coeffs.begin(); it!=end; ++it) {
+                const keyT& key = it->first;
+                if (it->second.has_coeff()) {
+                    keys.push_back(key);
+                    if (keys.size() == nbatch) {
+                        world.taskq.add(*this, &implT:: template multiop_values_batch_doit<opT>, keys, op, v);
+                        keys.clear();
+                    }
+                }
+                else
+                    coeffs.replace(key, nodeT(coeffT(),true));
+            }
+            if (keys.size() > 0)
+                world.taskq.add(*this, &implT:: template multiop_values_batch_doit<opT>, keys, op, v);
+            world.gop.fence();
+        }
+
         /// Transforms a vector of functions left[i] = sum[j] right[j]*c[j,i] using sparsity
         template <typename Q, typename R>
         void vtransform(const std::vector< std::shared_ptr< FunctionImpl<R,NDIM> > >& vright,
@@ -2339,8 +2623,20 @@ namespace madness {
                         const std::vector< std::shared_ptr< FunctionImpl<T,NDIM> > >& vleft,
                         double tol,
                         bool fence) {
-            for (unsigned int j=0; j<vright.size(); ++j) {
-                world.taskq.add(*this, &implT:: template vtransform_doit<Q,R>, vright[j], copy(c(j,_)), vleft, tol);
+            typedef typename FunctionImpl<R,NDIM>::mapT rmapT;
+
+            // the union of the local keys of all right functions, processed in chunks
+            std::vector<const FunctionImpl<R,NDIM>*> right(vright.size());
+            for (unsigned int j=0; j<vright.size(); ++j) right[j]=vright[j].get();
+            std::shared_ptr<rmapT> rmap(new rmapT(FunctionImpl<R,NDIM>::make_key_vec_map(right)));
+
+            size_t chunk = (rmap->size()-1)/(3*4*5)+1;
+            typename rmapT::iterator rstart=rmap->begin();
+            while (rstart != rmap->end()) {
+                typename rmapT::iterator rend = rstart;
+                advance(rend,chunk);
+                world.taskq.add(*this, &implT:: template vtransform_doit<Q,R>, rstart, rend, rmap, c, vleft, tol);
+                rstart = rend;
             }
             if (fence)
                 world.gop.fence();
@@ -2482,6 +2778,8 @@ namespace madness {
                     rc = it->second.coeff().full_tensor_copy();
             }
 
+            typename MeasuredCost<NDIM>::timer timer(key);
+
             // both nodes are leaf nodes: multiply and return
             if (rc.size() && lc.size()) { // Yipee!
                 do_mul<L,R>(key, lc, std::make_pair(key,rc));
@@ -2532,6 +2830,113 @@ namespace madness {
         }
 
 
+        /// Multiplication with the truncation of the product fused into the recursive descent
+
+        /// Both operands must be redundant (sum coefficients on all levels) and
+        /// have their norm_tree.  A node of the product becomes a leaf as soon as
+        /// the norm of the product's difference coefficients below it, estimated
+        /// from the operands' norm_tree and sum coefficients, is below the
+        /// truncation threshold, so the nodes that truncate() would remove from
+        /// the product of mulXXa are never created.  Operand coefficients
+        /// pushed down from a leaf are polynomials without detail below.
+        /// @param[in]  lcin    sum coefficients of left pushed down from a leaf, or empty
+        /// @param[in]  rcin    sum coefficients of right pushed down from a leaf, or empty
+        template <typename L, typename R>
+        Void mulXXa_truncate(const keyT& key,
+                             const FunctionImpl<L,NDIM>* left, const Tensor<L>& lcin,
+                             const FunctionImpl<R,NDIM>* right,const Tensor<R>& rcin,
+                             double tol) {
+            typedef typename FunctionImpl<L,NDIM>::dcT::const_iterator literT;
+            typedef typename FunctionImpl<R,NDIM>::dcT::const_iterator riterT;
+
+            // norm of the operand in this box and of its difference coefficients below
+            Tensor<L> lc = lcin;
+            bool lleaf = (lc.size() != 0);
+            double lnorm, ldnorm=0.0;
+            if (not lleaf) {
+                literT it = left->coeffs.find(key).get();
+                MADNESS_ASSERT(it != left->coeffs.end());
+                MADNESS_ASSERT(it->second.has_coeff());
+                lc = it->second.coeff().full_tensor_copy();
+                lleaf = it->second.is_leaf();
+                lnorm = it->second.get_norm_tree();
+                if (not lleaf) ldnorm = sqrt(std::max(0.0,lnorm*lnorm-lc.normf()*lc.normf()));
+            }
+            if (lleaf) lnorm = lc.normf();
+
+            Tensor<R> rc = rcin;
+            bool rleaf = (rc.size() != 0);
+            double rnorm, rdnorm=0.0;
+            if (not rleaf) {
+                riterT it = right->coeffs.find(key).get();
+                MADNESS_ASSERT(it != right->coeffs.end());
+                MADNESS_ASSERT(it->second.has_coeff());
+                rc = it->second.coeff().full_tensor_copy();
+                rleaf = it->second.is_leaf();
+                rnorm = it->second.get_norm_tree();
+                if (not rleaf) rdnorm = sqrt(std::max(0.0,rnorm*rnorm-rc.normf()*rc.normf()));
+            }
+            if (rleaf) rnorm = rc.normf();
+
+            typename MeasuredCost<NDIM>::timer timer(key);
+
+            if (lleaf and rleaf) {
+                do_mul<L,R>(key, lc, std::make_pair(key,rc));
+                return None;
+            }
+
+            const double ttol = truncate_tol(tol, key);
+            if (lnorm*rnorm < ttol) {
+                coeffs.replace(key, nodeT(coeffT(cdata.vk,targs),false)); // Zero leaf node
+                return None;
+            }
+
+            // detail of the product below this box: from the details of the
+            // operands, and from the high-order part of the product of the
+            // polynomials as in autorefine_square_test
+            const double lsnorm = lc.normf(), rsnorm = rc.normf();
+            const double llo = lc(cdata.sh).normf(), rlo = rc(cdata.sh).normf();
+            const double lhi = sqrt(std::max(0.0,lsnorm*lsnorm-llo*llo));
+            const double rhi = sqrt(std::max(0.0,rsnorm*rsnorm-rlo*rlo));
+            const double dnorm = lsnorm*rdnorm + ldnorm*rsnorm + ldnorm*rdnorm
+                + llo*rhi + lhi*rlo + lhi*rhi;
+            if (dnorm < ttol) {
+                do_mul<L,R>(key, lc, std::make_pair(key,rc));
+                return None;
+            }
+
+            // Recur down
+            coeffs.replace(key, nodeT(coeffT(),true)); // Interior node
+
+            Tensor<L> lss;
+            if (lleaf) {
+                Tensor<L> ld(cdata.v2k);
+                ld(cdata.s0) = lc(___);
+                lss = left->unfilter(ld);
+            }
+
+            Tensor<R> rss;
+            if (rleaf) {
+                Tensor<R> rd(cdata.v2k);
+                rd(cdata.s0) = rc(___);
+                rss = right->unfilter(rd);
+            }
+
+            for (KeyChildIterator<NDIM> kit(key); kit; ++kit) {
+                const keyT& child = kit.key();
+                Tensor<L> ll;
+                Tensor<R> rr;
+                if (lleaf)
+                    ll = copy(lss(child_patch(child)));
+                if (rleaf)
+                    rr = copy(rss(child_patch(child)));
+
+                woT::task(coeffs.owner(child), &implT:: template mulXXa_truncate<L,R>, child, left, ll, right, rr, tol);
+            }
+
+            return None;
+        }
+
         // Binary operation on values using recursive descent and assuming same distribution
         template <typename L, typename R, typename opT>
         Void binaryXXa(const keyT& key,
@@ -2653,6 +3058,15 @@ namespace madness {
             //verify_tree();
         }
 
+        /// Multiplication with fused truncation, see mulXXa_truncate
+        template <typename L, typename R>
+        void mulXX_truncate(const FunctionImpl<L,NDIM>* left, const FunctionImpl<R,NDIM>* right, double tol, bool fence) {
+            if (world.rank() == coeffs.owner(cdata.key0))
+                mulXXa_truncate(cdata.key0, left, Tensor<L>(), right, Tensor<R>(), tol);
+            if (fence)
+                world.gop.fence();
+        }
+
         template <typename L, typename R, typename opT>
         void binaryXX(const FunctionImpl<L,NDIM>* left, const FunctionImpl<R,NDIM>* right,
                       const opT& op, bool fence) {
@@ -2746,6 +3160,28 @@ namespace madness {
                               const coordT& plotlo, const coordT& plothi, const std::vector<long>& npt,
                               bool eval_refine) const;
 
+        /// The index of the first plot point of a box and the values at all plot points in the box
+        typedef std::pair< Vector<long,NDIM>, Tensor<T> > plotboxT;
+
+        /// Evaluates a leaf box at the plot points inside it ... plotlo and plothi are in simulation coordinates
+
+        /// The Legendre polynomials are tabulated on the plot points of the box
+        /// in each dimension and the coefficients are transformed to the points
+        /// with one matrix product per dimension.
+        /// @param[out] ilo the index of the first plot point in the box in each dimension
+        /// @return the values at the plot points in the box, empty if there are none
+        Tensor<T> eval_plot_box(const keyT& key, const coordT& plotlo, const coordT& plothi,
+                                const std::vector<long>& npt, bool eval_refine, Vector<long,NDIM>& ilo) const;
+
+        Void plot_box_kernel(archive::archive_ptr< std::vector<plotboxT> > ptr, long i, const keyT& key,
+                             const coordT& plotlo, const coordT& plothi, const std::vector<long>& npt) const;
+
+        /// Evaluate the points of a cube/slice in the local leaf boxes ... plotlo and plothi are already in simulation coordinates
+
+        /// No communications; the boxes of all processes together cover the cube.
+        std::vector<plotboxT> eval_plot_boxes(const coordT& plotlo, const coordT& plothi,
+                                              const std::vector<long>& npt) const;
+
 
         /// Evaluate a cube/slice of points ... plotlo and plothi are already in simulation coordinates
 
@@ -2772,6 +3208,29 @@ namespace madness {
                   const keyT& keyin,
                   const typename Future<T>::remote_refT& ref);
 
+        /// Evaluate the function at many points in \em simulation coordinates
+
+        /// Each point is walked down the local part of the tree starting from
+        /// its key.  The points are sorted by their leaf and all points of a
+        /// leaf are evaluated with one kernel; points that continue on another
+        /// process are sent there in one message per process.
+        /// @param[in] x    the points
+        /// @param[in] key  the box of each point to start from, usually key0()
+        /// @return the values in the order of the points
+        Future< std::vector<T> > eval_points(const std::vector<coordT>& x, const std::vector<keyT>& key);
+
+        /// Puts the values of the points that were evaluated on other processes into place
+        std::vector<T> eval_points_merge(const std::vector<T>& values,
+                                         const std::vector< std::vector<std::size_t> >& index,
+                                         const std::vector< Future< std::vector<T> > >& remote) const;
+
+        /// Evaluates the coefficients of a box at the points in x selected by index
+
+        /// The Legendre polynomials of all points are tabulated first and the
+        /// first dimension is contracted with a single matrix product.
+        void eval_cube_points(const keyT& key, const tensorT& c, const std::vector<coordT>& x,
+                              const std::vector<std::size_t>& index, std::vector<T>& values) const;
+
         /// Get the depth of the tree at a point in \em simulation coordinates
 
         /// Only the invoking process will get the result via the
@@ -3699,6 +4158,14 @@ namespace madness {
         /// @param[in]  targs   target tensor arguments (threshold and full/low rank)
         void reduce_rank(const TensorArgs& targs, bool fence);
 
+        /// store the coefficients in reduced precision where the truncation threshold allows
+
+        /// only norm2 and inner products are supported for compact functions
+        void compact(bool fence);
+
+        /// restore the coefficients in full precision after compact
+        void expand(bool fence);
+
         T eval_cube(Level n, coordT& x, const tensorT& c) const;
 
         /// Transform sum coefficients at level n to sums+differences at level n-1
@@ -3849,19 +4316,59 @@ namespace madness {
         // Invoked on node where key is local
         Future<coeffT > compress_spawn(const keyT& key, bool nonstandard, bool keepleaves, bool redundant);
 
+        /// the number of tree levels that are processed within a single task in compress/reconstruct
+        static int fuse_depth() {
+            return (NDIM<=3) ? 2 : 1;
+        }
+
+        /// true if the work on the subtree at key is done in the task of its parent
+
+        /// Local leaves are always processed in the parent task, local interior
+        /// nodes start a new task every fuse_depth() levels, so there are still
+        /// enough tasks for the threads, but far fewer than one per node.
+        /// Remote nodes always get their own task.
+        bool fuse_with_parent(const keyT& key) const {
+            if (not coeffs.is_local(key)) return false;
+            if (key.level()%fuse_depth()!=0) return true;
+            typename dcT::const_iterator it=coeffs.find(key).get();
+            return (it==coeffs.end()) or (it->second.is_leaf());
+        }
+
         /// convert this to redundant, i.e. have sum coefficients on all levels
         void make_redundant(const bool fence);
 
         /// convert this from redundant to standard reconstructed form
         void undo_redundant(const bool fence);
 
+        /// update the sum coefficients of a redundant tree on the paths to modified nodes
+        void make_redundant_incremental(const bool fence);
+
+        /// recompute the sum coefficients of the modified nodes below key
+        Future<coeffT> make_redundant_spawn(const keyT& key);
 
         /// compute for each FunctionNode the norm of the function inside that node
         void norm_tree(bool fence);
 
+        /// recompute norm_tree only on the paths to nodes modified since the last pass
+        void norm_tree_incremental(bool fence);
+
         double norm_tree_op(const keyT& key, const std::vector< Future<double> >& v);
 
-        Future<double> norm_tree_spawn(const keyT& key);
+        /// If incremental, clean subtrees return their stored norm_tree
+        Future<double> norm_tree_spawn(const keyT& key, bool incremental);
+
+        /// mark the parents of all local nodes with any of the flags as dirty, up to the root
+        void propagate_dirty(unsigned char flags, bool fence);
+
+        /// Returns the number of nodes recomputed by norm_tree, truncate and make_redundant passes
+
+        /// Sums the counts over all processes, hence collective.
+        long get_nodes_touched() const;
+
+        /// Resets the counter of nodes recomputed by tree passes
+        void reset_nodes_touched() {
+            nodes_touched=0;
+        }
 
         /// truncate using a tree in reconstructed form
 
@@ -3942,6 +4449,69 @@ namespace madness {
             }
         };
 
+        /// the number of contributions to a destination node that triggers sending the buffer entry
+        static int max_apply_buffer_count() {
+            return 16;
+        }
+
+        /// put an apply result into the per-destination buffer instead of sending it right away
+
+        /// All contributions to the same destination node that are computed in
+        /// this process are summed up locally, and only the sum is sent to the
+        /// destination with a single accumulate task.  That reduces the number of
+        /// active messages and the lock contention on popular destination nodes.
+        /// An entry is sent once it holds max_apply_buffer_count() contributions,
+        /// all remaining entries are sent by flush_apply_buffer.
+        /// Low-rank contributions are sent right away: their sum must be
+        /// accumulated through the orthogonalizing addition of the node.
+        /// @param[in]  result  the contribution to the destination node
+        /// @param[in]  dest    the destination node
+        /// @param[in]  args    TensorArgs for the accumulation
+        void buffer_apply_result(const coeffT& result, const keyT& dest, const TensorArgs& args) {
+            apply_buffer_nresult++;
+            if (result.tensor_type()!=TT_FULL) {
+                apply_buffer_nsend++;
+                coeffs.task(dest, &nodeT::accumulate, result, coeffs, dest, args, TaskAttributes::hipri());
+                return;
+            }
+            apply_buffer_entry entry;
+            {
+                typename apply_bufferT::accessor acc;
+                apply_buffer.insert(acc,dest);
+                apply_buffer_entry& e=acc->second;
+                if (e.count==0) {
+                    e.coeff=copy(result);
+                    e.args=args;
+                } else {
+                    result.append(e.coeff);
+                    e.args.thresh=std::min(e.args.thresh,args.thresh);
+                }
+                e.count++;
+                if (e.count<max_apply_buffer_count()) return;
+                entry=e;
+                apply_buffer.erase(acc);
+            }
+            apply_buffer_nsend++;
+            coeffs.task(dest, &nodeT::accumulate, entry.coeff, coeffs, dest, entry.args, TaskAttributes::hipri());
+        }
+
+        /// send all buffered apply results to their destination nodes
+
+        /// Must be called after all apply tasks have finished, i.e. after a fence,
+        /// and the accumulation requires another fence.
+        /// @param[in]  fence   fence after sending
+        void flush_apply_buffer(const bool fence) {
+            typename apply_bufferT::iterator end=apply_buffer.end();
+            for (typename apply_bufferT::iterator it=apply_buffer.begin(); it!=end; ++it) {
+                const keyT& dest=it->first;
+                const apply_buffer_entry& e=it->second;
+                apply_buffer_nsend++;
+                coeffs.task(dest, &nodeT::accumulate, e.coeff, coeffs, dest, e.args, TaskAttributes::hipri());
+            }
+            apply_buffer.clear();
+            if (fence) world.gop.fence();
+        }
+
         /// for fine-grain parallelism: call the apply method of an operator in a separate task
 
         /// @param[in]  op      the operator working on our function
@@ -3999,10 +4569,7 @@ namespace madness {
                 //double cpu1=cpu_time();
                 //timer_lr_result.accumulate(cpu1-cpu0);
 
-                Future<double> time=coeffs.task(args.dest, &nodeT::accumulate, result, coeffs, args.dest, apply_targs,
-                                                TaskAttributes::hipri());
-
-                //woT::task(world.rank(),&implT::accumulate_timer,time,TaskAttributes::hipri());
+                buffer_apply_result(result, args.dest, apply_targs);
             }
             return norm;
         }
@@ -4034,9 +4601,7 @@ namespace madness {
                 small++;
 
                 // accumulate also expects result in SVD form
-                Future<double> time=coeffs.task(args.dest, &nodeT::accumulate, result, coeffs, args.dest, apply_targs,
-                                                TaskAttributes::hipri());
-                //woT::task(world.rank(),&implT::accumulate_timer,time,TaskAttributes::hipri());
+                buffer_apply_result(result, args.dest, apply_targs);
 
             }
             return result_norm;
@@ -4058,7 +4623,7 @@ namespace madness {
 
             const opkeyT source=op->get_source_key(key);
 
-            // insert timer here
+            typename MeasuredCost<NDIM>::timer timer(key);
             double fac = 10.0; //3.0; // 10.0 seems good for qmprop ... 3.0 OK for others
             double cnorm = c.normf();
             //const long lmax = 1L << (key.level()-1);
@@ -4097,7 +4662,7 @@ namespace madness {
                         // } else {
                             tensorT result = op->apply(source, *it, c, tol/fac/cnorm);
                             if (result.normf()> 0.3*tol/fac) {
-                                coeffs.task(dest, &nodeT::accumulate2, result, coeffs, dest, TaskAttributes::hipri());
+                                buffer_apply_result(coeffT(result,-1.0,TT_FULL), dest, targs);
                             }
                         // }
                     } else if (d.distsq() >= 1)
@@ -4109,6 +4674,9 @@ namespace madness {
 
 
         /// apply an operator on f to return this
+
+        /// the results are collected in the apply buffer; without fence the
+        /// caller must fence and call flush_apply_buffer before using this
         template <typename opT, typename R>
         void apply(opT& op, const FunctionImpl<R,NDIM>& f, bool fence) {
             PROFILE_MEMBER_FUNC(FunctionImpl);
@@ -4126,8 +4694,10 @@ namespace madness {
                     }
                 }
             }
-            if (fence)
+            if (fence) {
                 world.gop.fence();
+                flush_apply_buffer(true);
+            }
 
             this->compressed=true;
             this->nonstandard=true;
@@ -4147,7 +4717,7 @@ namespace madness {
         double do_apply_directed_screening(const opT* op, const keyT& key, const coeffT& coeff,
                                            const bool& do_kernel) {
             PROFILE_MEMBER_FUNC(FunctionImpl);
-            // insert timer here
+            typename MeasuredCost<NDIM>::timer timer(key);
             typedef typename opT::keyT opkeyT;
 
             // screening: contains all displacement keys that had small result norms
@@ -4258,10 +4828,15 @@ namespace madness {
                     woT::task(p, &implT:: template do_apply_directed_screening<opT,R>, &op, key, coeff, false);
                 }
             }
-            if (fence) world.gop.fence();
+            if (fence) {
+                world.gop.fence();
+                flush_apply_buffer(true);
+            }
         }
 
         /// after apply we need to do some cleanup;
+
+        /// also sends the buffered apply results, so all apply tasks must be done
         double finalize_apply(const bool fence=true);
 
         /// traverse a non-existing tree, make its coeffs and apply an operator
@@ -4601,8 +5176,8 @@ namespace madness {
         struct do_norm2sq_local {
             double operator()(typename dcT::const_iterator& it) const {
                 const nodeT& node = it->second;
-                if (node.has_coeff()) {
-                    double norm = node.coeff().normf();
+                if (node.has_coeff() or node.is_compact()) {
+                    double norm = node.full_precision_coeff().normf();
                     return norm*norm;
                 }
                 else {
@@ -4623,6 +5198,22 @@ namespace madness {
         /// Returns the square of the local norm ... no comms
         double norm2sq_local() const;
 
+        /// Returns the squares of the local norms of many functions ... no comms
+
+        /// The reductions of all functions are started before the first one
+        /// is waited for, so that the trees are traversed concurrently.
+        static std::vector<double> norm2sq_local(const std::vector<const implT*>& v) {
+            typedef Range<typename dcT::const_iterator> rangeT;
+            std::vector< Future<double> > fnorm(v.size());
+            for (unsigned int i=0; i<v.size(); ++i) {
+                fnorm[i]=v[i]->world.taskq.template reduce<double,rangeT,do_norm2sq_local>
+                    (rangeT(v[i]->coeffs.begin(),v[i]->coeffs.end()),do_norm2sq_local());
+            }
+            std::vector<double> norms(v.size());
+            for (unsigned int i=0; i<v.size(); ++i) norms[i]=fnorm[i].get();
+            return norms;
+        }
+
         /// compute the inner product of this range with other
         template<typename R>
         struct do_inner_local {
@@ -4637,20 +5228,23 @@ namespace madness {
             	TENSOR_RESULT_TYPE(T,R) sum=0.0;
             	const keyT& key=it->first;
                 const nodeT& fnode = it->second;
-                if (fnode.has_coeff()) {
+                if (fnode.has_coeff() or fnode.is_compact()) {
                     if (other->coeffs.probe(it->first)) {
                         const FunctionNode<R,NDIM>& gnode = other->coeffs.find(key).get()->second;
-                        if (gnode.has_coeff()) {
-                            if (gnode.coeff().dim(0) != fnode.coeff().dim(0)) {
-                                madness::print("INNER", it->first, gnode.coeff().dim(0),fnode.coeff().dim(0));
+                        if (gnode.has_coeff() or gnode.is_compact()) {
+                            // compact coefficients are promoted on the fly
+                            const coeffT fcoeff=fnode.full_precision_coeff();
+                            const typename FunctionNode<R,NDIM>::coeffT gcoeff=gnode.full_precision_coeff();
+                            if (gcoeff.dim(0) != fcoeff.dim(0)) {
+                                madness::print("INNER", it->first, gcoeff.dim(0),fcoeff.dim(0));
                                 MADNESS_EXCEPTION("functions have different k or compress/reconstruct error", 0);
                             }
                             if (leaves_only) {
                                 if (gnode.is_leaf() or fnode.is_leaf()) {
-                                    sum += fnode.coeff().trace_conj(gnode.coeff());
+                                    sum += fcoeff.trace_conj(gcoeff);
                                 }
                             } else {
-                                sum += fnode.coeff().trace_conj(gnode.coeff());
+                                sum += fcoeff.trace_conj(gcoeff);
                             }
                         }
                     }
@@ -4690,13 +5284,15 @@ namespace madness {
         typedef ConcurrentHashMap< keyT, mapvecT > mapT;
 
         /// Adds keys to union of local keys with specified index
-        void add_keys_to_map(mapT* map, int index) const {
+
+        /// If a support index is given, keys in boxes the function does not occupy are left out
+        void add_keys_to_map(mapT* map, int index, const SupportIndex<NDIM>* support) const {
             typename dcT::const_iterator end = coeffs.end();
             for (typename dcT::const_iterator it=coeffs.begin(); it!=end; ++it) {
                 typename mapT::accessor acc;
                 const keyT& key = it->first;
                 const FunctionNode<T,NDIM>& node = it->second;
-                if (node.has_coeff()) {
+                if (node.has_coeff() and (not support or support->occupies(index,key))) {
                     map->insert(acc,key);
                     acc->second.push_back(std::make_pair(index,&(node.coeff())));
                 }
@@ -4708,18 +5304,79 @@ namespace madness {
         /// Local concurrency and synchronization only; no communication
         static
         mapT
-        make_key_vec_map(const std::vector<const FunctionImpl<T,NDIM>*>& v) {
+        make_key_vec_map(const std::vector<const FunctionImpl<T,NDIM>*>& v,
+                         const SupportIndex<NDIM>* support=0) {
             mapT map(100000);
             // This loop must be parallelized
             for (unsigned int i=0; i<v.size(); i++) {
                 //v[i]->add_keys_to_map(&map,i);
-                v[i]->world.taskq.add(*(v[i]), &FunctionImpl<T,NDIM>::add_keys_to_map, &map, int(i));
+                v[i]->world.taskq.add(*(v[i]), &FunctionImpl<T,NDIM>::add_keys_to_map, &map, int(i), support);
             }
             if (v.size()) v[0]->world.taskq.fence();
             return map;
         }
 
 
+        /// Packs the coefficients of one key of many functions into the rows of a matrix
+
+        /// Returns an empty tensor if a coefficient is not full rank or the
+        /// sizes of the coefficients differ; the caller must then fall back
+        /// to the pairwise inner products.
+        /// @param[in]  v           the coefficients of one key of many functions
+        /// @param[in]  conjugate   store the complex conjugate of the coefficients
+        static Tensor<T> pack_panel(const mapvecT& v, const bool conjugate) {
+            const long n=v.size();
+            const long size=v[0].second->size();
+            for (long iv=0; iv<n; ++iv) {
+                if ((v[iv].second->tensor_type()!=TT_FULL) or (v[iv].second->size()!=size)) return Tensor<T>();
+            }
+            Tensor<T> panel(n,size);
+            for (long iv=0; iv<n; ++iv) {
+                Tensor<T> c=v[iv].second->full_tensor();
+                if (not c.iscontiguous()) c=copy(c);
+                const T* restrict src=c.ptr();
+                T* restrict dst=panel.ptr()+iv*size;
+                if (conjugate) for (long k=0; k<size; ++k) dst[k]=conj(src[k]);
+                else for (long k=0; k<size; ++k) dst[k]=src[k];
+            }
+            return panel;
+        }
+
+        /// Accumulates the inner products of all rows of two panels: r(i,j) += sum(k) a(i,k)*b(j,k)
+        template <typename Q, typename S>
+        static void inner_panels(const Tensor<Q>& a, const Tensor<S>& b,
+                                 Tensor< TENSOR_RESULT_TYPE(Q,S) >& r) {
+            inner_result(a,b,1,1,r);
+        }
+
+        /// Accumulates the inner products of all rows of two panels of the same type with GEMM
+        template <typename Q>
+        static void inner_panels(const Tensor<Q>& a, const Tensor<Q>& b, Tensor<Q>& r) {
+            // the row-major r is the column-major r^T = b a^T
+            const Q one(1.0);
+            cblas::gemm(cblas::Trans, cblas::NoTrans, b.dim(0), a.dim(0), a.dim(1),
+                        one, b.ptr(), b.dim(1), a.ptr(), a.dim(1), one, r.ptr(), r.dim(1));
+        }
+
+        /// Accumulates the inner products of all rows of a panel with themselves, r(i,j) for j>=i only
+        template <typename Q>
+        static void inner_panel_sym(const Tensor<Q>& a, Tensor<Q>& r) {
+            inner_panels(a,a,r);
+        }
+
+        /// Accumulates the inner products of all rows of a real panel with themselves with SYRK
+        static void inner_panel_sym(const Tensor<double>& a, Tensor<double>& r) {
+            // the upper triangle of the row-major r is the lower triangle of the column-major r^T
+            cblas::syrk(true, cblas::Trans, a.dim(0), a.dim(1), 1.0, a.ptr(), a.dim(1), 1.0, r.ptr(), r.dim(1));
+        }
+
+        /// Computes the inner products of all pairs of functions on a range of keys
+
+        /// On each key the coefficients of all left and all right functions are
+        /// packed into two contiguous panels, and all inner products are
+        /// computed with a single matrix multiplication into a thread-local
+        /// tile.  Symmetric real products use a rank-k update instead.
+        /// Low-rank coefficients are handled pairwise.
         template <typename R>
         static void do_inner_localX(const typename mapT::iterator lstart,
                                     const typename mapT::iterator lend,
@@ -4727,7 +5384,8 @@ namespace madness {
                                     const bool sym,
                                     Tensor< TENSOR_RESULT_TYPE(T,R) >& result,
                                     Mutex* mutex) {
-            Tensor< TENSOR_RESULT_TYPE(T,R) > r(result.dim(0),result.dim(1));
+            typedef TENSOR_RESULT_TYPE(T,R) resultT;
+            Tensor<resultT> r(result.dim(0),result.dim(1));
             for (typename mapT::iterator lit=lstart; lit!=lend; ++lit) {
                 const keyT& key = lit->first;
                 typename FunctionImpl<R,NDIM>::mapT::iterator rit=rmap_ptr->find(key);
@@ -4736,6 +5394,37 @@ namespace madness {
                     const typename FunctionImpl<R,NDIM>::mapvecT& rightv =rit->second;
                     const int nleft = leftv.size();
                     const int nright= rightv.size();
+                    const bool same=((const void*)(&leftv)==(const void*)(&rightv));
+
+                    const Tensor<T> a=pack_panel(leftv,true);
+                    if (a.size()>0 and sym and same and not TensorTypeData<T>::iscomplex) {
+                        // a is not conjugated for real types, so it serves as right panel as well
+                        Tensor<T> tile(nleft,nleft);
+                        inner_panel_sym(a,tile);
+                        for (int iv=0; iv<nleft; iv++) {
+                            const int i = leftv[iv].first;
+                            for (int jv=iv; jv<nleft; jv++) {
+                                const int j = leftv[jv].first;
+                                r(std::min(i,j),std::max(i,j)) += tile(iv,jv);
+                            }
+                        }
+                        continue;
+                    }
+
+                    const Tensor<R> b= (a.size()>0) ? FunctionImpl<R,NDIM>::pack_panel(rightv,false) : Tensor<R>();
+                    if (a.size()>0 and b.size()>0 and a.dim(1)==b.dim(1)) {
+                        Tensor<resultT> tile(nleft,nright);
+                        inner_panels(a,b,tile);
+                        for (int iv=0; iv<nleft; iv++) {
+                            const int i = leftv[iv].first;
+                            for (int jv=0; jv<nright; jv++) {
+                                const int j = rightv[jv].first;
+                                if (!sym || (sym && i<=j))
+                                    r(i,j) += tile(iv,jv);
+                            }
+                        }
+                        continue;
+                    }
 
                     for (int iv=0; iv<nleft; iv++) {
                         const int i = leftv[iv].first;
@@ -4768,11 +5457,17 @@ namespace madness {
             return std::conj(x);
         }
 
+        static std::complex<float> conj(const std::complex<float> x) {
+            return std::conj(x);
+        }
+
         template <typename R>
         static Tensor< TENSOR_RESULT_TYPE(T,R) >
         inner_local(const std::vector<const FunctionImpl<T,NDIM>*>& left,
                     const std::vector<const FunctionImpl<R,NDIM>*>& right,
-                    bool sym) {
+                    bool sym,
+                    const SupportIndex<NDIM>* lsupport=0,
+                    const SupportIndex<NDIM>* rsupport=0) {
 
             // This is basically a sparse matrix^T * matrix product
             // Rij = sum(k) Aki * Bkj
@@ -4786,11 +5481,15 @@ namespace madness {
             //             do k in ktile
             //                Rij += Aki*Bkj
 
-            mapT lmap = make_key_vec_map(left);
+            //
+            // With support indices the coefficients of a function in boxes
+            // it does not occupy are left out of the products.
+
+            mapT lmap = make_key_vec_map(left, lsupport);
             typename FunctionImpl<R,NDIM>::mapT rmap;
             typename FunctionImpl<R,NDIM>::mapT* rmap_ptr = (typename FunctionImpl<R,NDIM>::mapT*)(&lmap);
             if ((std::vector<const FunctionImpl<R,NDIM>*>*)(&left) != &right) {
-                rmap = FunctionImpl<R,NDIM>::make_key_vec_map(right);
+                rmap = FunctionImpl<R,NDIM>::make_key_vec_map(right, rsupport);
                 rmap_ptr = &rmap;
             }
 
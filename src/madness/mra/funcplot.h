@@ -34,6 +34,10 @@
 #define MADNESS_MRA_FUNCPLOT_H__INCLUDED
 
 #include <madness/constants.h>
+#include <algorithm>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 /*!
 
@@ -81,7 +85,8 @@ namespace madness {
     /// @param npt Vector of long integers indicating the number of points to plot in each dimension
     /// @param binary (optional) Boolean indicating whether to print in binary
 
-    /// The VTK routines are also designed for SERIAL data, parallel coming...
+    /// The VTK routines are also designed for SERIAL data; plotvtk_image writes
+    /// large grids in parallel.
     ///
     /// This header is templated by the dimension of the data.
     ///
@@ -318,6 +323,156 @@ namespace madness {
         world.gop.fence();
     }
 
+    namespace detail {
+        /// A plot point: the position in the file and the components of the value
+        struct plotvtk_point {
+            uint64_t pos;
+            float v[2];
+            bool operator<(const plotvtk_point& other) const {return pos < other.pos;}
+        };
+
+        template <typename T>
+        struct plotvtk_ncomp {static const int n = 1;};
+
+        template <typename T>
+        struct plotvtk_ncomp< std::complex<T> > {static const int n = 2;};
+
+        template <typename T>
+        inline void plotvtk_components(const T& x, float* v) {v[0] = float(x);}
+
+        template <typename T>
+        inline void plotvtk_components(const std::complex<T>& x, float* v) {
+            v[0] = float(real(x));
+            v[1] = float(imag(x));
+        }
+    }
+
+    /// Writes a function on a uniform grid as VTK XML ImageData with raw binary data, in parallel
+
+    /// Collective operation.  Process 0 writes the XML header and footer;
+    /// every process evaluates the grid points in its own leaf boxes
+    /// (Function::eval_cube_local) and writes their values directly at
+    /// their offsets in the file, merging points that are adjacent in the
+    /// file into one write.  No process holds the whole grid and there is
+    /// no communication besides fences, but all processes must see the same
+    /// file system.  The values are written as Float32; complex functions
+    /// have two components (real and imaginary part).  By convention the
+    /// file ends in ".vti" and it is read by Paraview or VisIt.
+    ///
+    /// @param f The function to plot
+    /// @param fieldname The name of the field in the file
+    /// @param filename The name of the file
+    /// @param plotlo Vector of double values indicating the minimum coordinate to plot to in each dimension
+    /// @param plothi Vector of double values indicating the maximum coordinate to plot to in each dimension
+    /// @param npt Vector of long integers indicating the number of points to plot in each dimension
+    template <typename T, std::size_t NDIM>
+    void plotvtk_image(const Function<T,NDIM>& f, const char* fieldname, const char* filename,
+                       const Vector<double,NDIM>& plotlo, const Vector<double,NDIM>& plothi,
+                       const Vector<long,NDIM>& npt) {
+        PROFILE_FUNC;
+        MADNESS_ASSERT(NDIM>=1 && NDIM<=3);
+        World& world = f.world();
+        const int ncomp = detail::plotvtk_ncomp<T>::n;
+
+        uint64_t npoint = 1;
+        for (std::size_t d=0; d<NDIM; ++d) npoint *= npt[d];
+        const uint64_t nbyte = npoint*ncomp*sizeof(float);
+
+        // Header and footer; the data follow the header and its size
+        long offset = 0;
+        if (world.rank() == 0) {
+            const int one = 1;
+            const bool little = *reinterpret_cast<const char*>(&one);
+            std::ostringstream extent, origin, spacing;
+            for (std::size_t d=0; d<3; ++d) {
+                extent << "0 " << ((d<NDIM) ? npt[d]-1 : 0) << " ";
+                origin << ((d<NDIM) ? plotlo[d] : 0.0) << " ";
+                spacing << ((d<NDIM && npt[d]>1) ? (plothi[d]-plotlo[d])/(npt[d]-1) : 1.0) << " ";
+            }
+            std::ostringstream header;
+            header << "<?xml version=\"1.0\"?>\n"
+                   << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\""
+                   << (little ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n"
+                   << "  <ImageData WholeExtent=\"" << extent.str() << "\" Origin=\"" << origin.str()
+                   << "\" Spacing=\"" << spacing.str() << "\">\n"
+                   << "    <Piece Extent=\"" << extent.str() << "\">\n"
+                   << "      <PointData Scalars=\"" << fieldname << "\">\n"
+                   << "        <DataArray type=\"Float32\" Name=\"" << fieldname
+                   << "\" NumberOfComponents=\"" << ncomp << "\" format=\"appended\" offset=\"0\"/>\n"
+                   << "      </PointData>\n"
+                   << "      <CellData>\n"
+                   << "      </CellData>\n"
+                   << "    </Piece>\n"
+                   << "  </ImageData>\n"
+                   << "  <AppendedData encoding=\"raw\">\n"
+                   << "   _";
+            const std::string footer = "\n  </AppendedData>\n</VTKFile>\n";
+
+            FILE* file = fopen(filename, "wb");
+            if (!file) MADNESS_EXCEPTION("plotvtk_image: failed to open the plot file", 0);
+            fwrite(header.str().c_str(), 1, header.str().size(), file);
+            fwrite(&nbyte, sizeof(nbyte), 1, file);
+            offset = header.str().size() + sizeof(nbyte);
+            fseek(file, offset+nbyte, SEEK_SET);
+            fwrite(footer.c_str(), 1, footer.size(), file);
+            fclose(file);
+        }
+        world.gop.broadcast(offset);
+
+        Tensor<double> cell(NDIM, 2);
+        std::vector<long> numpt(NDIM);
+        for (std::size_t d=0; d<NDIM; ++d) {
+            cell(d,0) = plotlo[d];
+            cell(d,1) = plothi[d];
+            numpt[d] = npt[d];
+        }
+        const std::vector< std::pair< Vector<long,NDIM>, Tensor<T> > > boxes = f.eval_cube_local(cell, numpt);
+
+        // The position in the file of all local points; VTK runs the first dimension fastest
+        std::vector<detail::plotvtk_point> points;
+        for (std::size_t b=0; b<boxes.size(); ++b) {
+            const Vector<long,NDIM>& ilo = boxes[b].first;
+            const Tensor<T>& t = boxes[b].second;
+            MADNESS_ASSERT(t.iscontiguous());
+            const T* p = t.ptr();
+            for (long j=0; j<t.size(); ++j) {
+                long idx[NDIM];
+                long rem = j;
+                for (int d=NDIM-1; d>=0; --d) {
+                    idx[d] = rem % t.dim(d);
+                    rem /= t.dim(d);
+                }
+                detail::plotvtk_point point;
+                point.pos = 0;
+                for (int d=NDIM-1; d>=0; --d) point.pos = point.pos*npt[d] + ilo[d] + idx[d];
+                detail::plotvtk_components(p[j], point.v);
+                points.push_back(point);
+            }
+        }
+        std::sort(points.begin(), points.end());
+
+        world.gop.fence();
+        int fd = open(filename, O_WRONLY);
+        if (fd < 0) MADNESS_EXCEPTION("plotvtk_image: failed to open the plot file", world.rank());
+        std::vector<float> buf;
+        for (std::size_t i=0; i<points.size(); ) {
+            // collect a run of consecutive points
+            std::size_t j = i;
+            buf.clear();
+            while (j<points.size() && points[j].pos == points[i].pos+(j-i)) {
+                buf.insert(buf.end(), points[j].v, points[j].v+ncomp);
+                ++j;
+            }
+            const size_t size = buf.size()*sizeof(float);
+            if (pwrite(fd, &buf[0], size, offset + points[i].pos*ncomp*sizeof(float)) != ssize_t(size)) {
+                MADNESS_EXCEPTION("plotvtk_image: failed to write the plot file", world.rank());
+            }
+            i = j;
+        }
+        close(fd);
+        world.gop.fence();
+    }
+
     namespace detail {
         inline unsigned short htons_x(unsigned short a) {
             return (a>>8) | (a<<8);
@@ -400,10 +555,12 @@ namespace madness {
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            const std::vector<T> fval = f.eval_points(r).get();
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
+                plot_line_print_value(file, fval[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -431,11 +588,14 @@ namespace madness {
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            const std::vector<T> fval = f.eval_points(r).get();
+            const std::vector<U> gval = g.eval_points(r).get();
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
+                plot_line_print_value(file, fval[i]);
+                plot_line_print_value(file, gval[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -465,12 +625,16 @@ namespace madness {
             FILE* file = fopen(filename,"w");
 	    if(!file)
 	      MADNESS_EXCEPTION("plot_line: failed to open the plot file", 0);
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            const std::vector<T> fval = f.eval_points(r).get();
+            const std::vector<U> gval = g.eval_points(r).get();
+            const std::vector<V> aval = a.eval_points(r).get();
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
-                plot_line_print_value(file, a.eval(r));
+                plot_line_print_value(file, fval[i]);
+                plot_line_print_value(file, gval[i]);
+                plot_line_print_value(file, aval[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
@@ -498,13 +662,18 @@ namespace madness {
         b.reconstruct();
         if (world.rank() == 0) {
             FILE* file = fopen(filename,"w");
+            std::vector<coordT> r(npt);
+            for (int i=0; i<npt; ++i) r[i] = lo + h*double(i);
+            const std::vector<T> fval = f.eval_points(r).get();
+            const std::vector<U> gval = g.eval_points(r).get();
+            const std::vector<V> aval = a.eval_points(r).get();
+            const std::vector<W> bval = b.eval_points(r).get();
             for (int i=0; i<npt; ++i) {
-                coordT r = lo + h*double(i);
                 fprintf(file, "%.14e ", i*sum);
-                plot_line_print_value(file, f.eval(r));
-                plot_line_print_value(file, g.eval(r));
-                plot_line_print_value(file, a.eval(r));
-                plot_line_print_value(file, b.eval(r));
+                plot_line_print_value(file, fval[i]);
+                plot_line_print_value(file, gval[i]);
+                plot_line_print_value(file, aval[i]);
+                plot_line_print_value(file, bval[i]);
                 fprintf(file,"\n");
             }
             fclose(file);
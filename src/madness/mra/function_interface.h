@@ -93,6 +93,18 @@ namespace madness {
                     MADNESS_EXCEPTION("FunctionFunctorInterface: This function should not be called!", 0);
                 }
 
+                /// Does the interface support evaluation on a tensor-product grid?
+                virtual bool supports_grid() const {return false;}
+
+                /// Evaluates the function on the tensor-product grid x[0] x x[1] x ... of npt points per dimension
+
+                /// Values are returned in fvals with the last dimension fastest.
+                /// Separable functions (e.g., sums of Gaussians) should implement
+                /// this from 1D factors, which avoids npt^NDIM transcendentals.
+                virtual void operator()(const Vector<const double*,NDIM>& x, int npt, T* fvals) const {
+                    MADNESS_EXCEPTION("FunctionFunctorInterface: This function should not be called!", 0);
+                }
+
 		/// You should implement this to return \c f(x)
 		virtual T operator()(const Vector<double, NDIM>& x) const = 0;
 
@@ -238,6 +250,171 @@ namespace madness {
         T operator()(const coordT& x) const {return op(x);}
     };
 
+    /// Base class for functions that are sums of products of 1D factors
+
+    /// f(x) = sum_mu prod_d f_{mu,d}(x_d).  The scaling coefficients of a
+    /// term are the outer product of the 1D projections of its factors, so
+    /// a box costs O(NDIM*k^2) per term for the projections plus one GEMM
+    /// over the terms for the assembly, instead of k^NDIM evaluations of f.
+    /// The coefficients are returned in low-rank form if the default tensor
+    /// type is TT_2D.
+    template<typename T, std::size_t NDIM>
+    class SeparableFunctor : public FunctionFunctorInterface<T,NDIM> {
+    public:
+        typedef GenTensor<T> coeffT;
+        typedef Vector<double, NDIM> coordT; ///< Type of vector holding coordinates
+
+        SeparableFunctor(int k=FunctionDefaults<NDIM>::get_k()) : k(k) {}
+
+        /// Returns the number of terms
+        virtual long nterms() const = 0;
+
+        /// Evaluates the factor of term mu in dimension d at the npt points x
+        virtual void factor(long mu, std::size_t d, const double* x, int npt, T* f) const = 0;
+
+        T operator()(const coordT& x) const {
+            T sum = 0.0;
+            for (long mu=0; mu<nterms(); ++mu) {
+                T prod = 1.0;
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    T f;
+                    factor(mu, d, &x[d], 1, &f);
+                    prod *= f;
+                }
+                sum += prod;
+            }
+            return sum;
+        }
+
+        bool supports_grid() const {return true;}
+
+        void operator()(const Vector<const double*,NDIM>& x, int npt, T* fvals) const {
+            const long nmu = nterms();
+            std::vector< Tensor<T> > f(NDIM);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                f[d] = Tensor<T>(nmu,npt);
+                for (long mu=0; mu<nmu; ++mu) factor(mu, d, x[d], npt, f[d].ptr()+mu*npt);
+            }
+            const Tensor<T> r = sum_of_products(f);
+            std::copy(r.ptr(), r.ptr()+r.size(), fvals);
+        }
+
+        bool provides_coeff() const {return true;}
+
+        coeffT coeff(const Key<NDIM>& key) const {
+            const FunctionCommonData<T,NDIM>& cdata = FunctionCommonData<T,NDIM>::get(k);
+            const Tensor<double>& cell = FunctionDefaults<NDIM>::get_cell();
+            const Tensor<double>& cell_width = FunctionDefaults<NDIM>::get_cell_width();
+            const double h = std::pow(0.5,double(key.level()));
+            const long nmu = nterms();
+            const int npt = cdata.npt;
+
+            // 1D scaling coefficients s[d](mu,i) of all factors
+            std::vector< Tensor<T> > s(NDIM);
+            std::vector<double> x(npt);
+            Tensor<T> fval(nmu,npt);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const double hw = h*cell_width[d];
+                for (int q=0; q<npt; ++q) {
+                    x[q] = cell(d,0) + hw*(key.translation()[d] + cdata.quad_x(q));
+                }
+                for (long mu=0; mu<nmu; ++mu) factor(mu, d, &x[0], npt, fval.ptr()+mu*npt);
+                s[d] = inner(fval, cdata.quad_phiw);
+                s[d].scale(sqrt(hw));
+            }
+
+#if HAVE_GENTENSOR
+            if (FunctionDefaults<NDIM>::get_tensor_type()==TT_2D and NDIM%2==0) {
+                Tensor<double> weights(nmu);
+                weights = 1.0;
+                coeffT result(SRConf<T>(weights, khatri_rao(s,0,NDIM/2),
+                        khatri_rao(s,NDIM/2,NDIM), NDIM, k));
+                result.normalize();
+                result.randomized_reduce_rank(FunctionDefaults<NDIM>::get_thresh());
+                return result;
+            }
+#endif
+            return coeffT(sum_of_products(s),FunctionDefaults<NDIM>::get_thresh(),TT_FULL);
+        }
+
+    protected:
+        /// the wavelet order of the coefficients
+        int k;
+
+        /// Khatri-Rao product of the factors of dimensions [dlo,dhi): r(mu,(i_dlo,...)) = prod_d f[d](mu,i_d)
+        static Tensor<T> khatri_rao(const std::vector< Tensor<T> >& f, std::size_t dlo, std::size_t dhi) {
+            const long nmu = f[0].dim(0);
+            Tensor<T> r(nmu,1L);
+            r = T(1.0);
+            for (std::size_t d=dlo; d<dhi; ++d) {
+                const long n = r.dim(1), m = f[d].dim(1);
+                Tensor<T> rd(nmu,n*m);
+                for (long mu=0; mu<nmu; ++mu) {
+                    const T* p = r.ptr()+mu*n;
+                    const T* q = f[d].ptr()+mu*m;
+                    T* out = rd.ptr()+mu*n*m;
+                    for (long i=0; i<n; ++i) {
+                        for (long j=0; j<m; ++j) out[i*m+j] = p[i]*q[j];
+                    }
+                }
+                r = rd;
+            }
+            return r;
+        }
+
+        /// Sums the outer products of all terms, r(i_0,...,i_{NDIM-1}) = sum_mu prod_d f[d](mu,i_d)
+
+        /// The sum over terms is a single GEMM between the Khatri-Rao products
+        /// of the first and second half of the dimensions.
+        static Tensor<T> sum_of_products(const std::vector< Tensor<T> >& f) {
+            const Tensor<T> r = inner(khatri_rao(f,0,NDIM/2), khatri_rao(f,NDIM/2,NDIM), 0, 0);
+            std::vector<long> dims(NDIM);
+            for (std::size_t d=0; d<NDIM; ++d) dims[d] = f[d].dim(1);
+            return r.reshape(dims);
+        }
+    };
+
+    /// A sum of isotropic Gaussians about a center, f(x) = sum_i c_i exp(-a_i |x-x0|^2)
+
+    /// Use the GFit factories to represent Slater or Coulomb-like functions.
+    template<typename T, std::size_t NDIM>
+    class GaussianSumFunctor : public SeparableFunctor<T,NDIM> {
+        typedef Vector<double, NDIM> coordT; ///< Type of vector holding coordinates
+
+        Tensor<T> coeffs;
+        Tensor<double> expnts;
+        coordT center;
+
+    public:
+        GaussianSumFunctor(const Tensor<T>& coeff, const Tensor<double>& expnt,
+                const coordT& center=coordT(0.0))
+            : coeffs(coeff), expnts(expnt), center(center) {
+            MADNESS_ASSERT(coeffs.size() == expnts.size());
+        }
+
+        /// The Gaussian expansion of a fit, e.g. GFit<double,NDIM>::SlaterFit(...)
+        GaussianSumFunctor(const GFit<T,NDIM>& fit, const coordT& center=coordT(0.0))
+            : coeffs(fit.coeffs()), expnts(fit.exponents()), center(center) {}
+
+        T operator()(const coordT& x) const {
+            double rsq = 0.0;
+            for (std::size_t d=0; d<NDIM; ++d) rsq += (x[d]-center[d])*(x[d]-center[d]);
+            T sum = 0.0;
+            for (long i=0; i<coeffs.size(); ++i) sum += coeffs(i)*exp(-expnts(i)*rsq);
+            return sum;
+        }
+
+        long nterms() const {return coeffs.size();}
+
+        void factor(long mu, std::size_t d, const double* x, int npt, T* f) const {
+            const T c = (d == 0) ? coeffs(mu) : T(1.0);
+            for (int i=0; i<npt; ++i) {
+                const double dx = x[i] - center[d];
+                f[i] = c*exp(-expnts(mu)*dx*dx);
+            }
+        }
+    };
+
 	/// FunctionInterface implements a wrapper around any class with the operator()()
 	template<typename T, size_t NDIM, typename opT>
 	class FunctionInterface : public FunctionFunctorInterface<T,NDIM> {
@@ -36,6 +36,7 @@
 #include <madness/madness_config.h>
 #include <map>
 #include <queue>
+#include <algorithm>
 #include <madness/world/atomicint.h>
 #include <madness/world/worlddc.h>
 
@@ -92,6 +93,168 @@ namespace madness {
 
 
 
+    /// A pmap that assigns contiguous segments of a space-filling curve to processes
+
+    /// Keys are ordered along the Morton (Z-order) curve by their ancestor on
+    /// a fixed partition level, or by their first descendant on that level if
+    /// they are above it.  The curve is split into nproc contiguous segments,
+    /// so that all descendants of a box on the partition level share the
+    /// owner, and spatial neighbors are mostly owned by the same process.
+    /// The segments are equally long by default; cost-weighted segments are
+    /// obtained from LoadBalanceDeux::load_balance_sfc.
+    template <std::size_t NDIM>
+    class SFCPmap : public WorldDCPmapInterface< Key<NDIM> > {
+        typedef Key<NDIM> keyT;
+        Level level;                ///< the partition level
+        std::vector<uint64_t> cuts; ///< cuts[p] is the first curve index owned by process p+1
+
+    public:
+        /// Returns the default partition level: about 64 boxes per process
+        static Level default_level(int nproc) {
+            Level n=1;
+            while ((n+1)*NDIM<=max_bits() and (uint64_t(1)<<(n*NDIM))<64*uint64_t(nproc)) ++n;
+            return n;
+        }
+
+        /// Returns the number of bits available for the curve index
+        static int max_bits() {return 62;}
+
+        /// Returns the position of the key on the Morton curve on the given level
+        static uint64_t curve_index(const keyT& key, const Level n) {
+            const Level l=key.level();
+            uint64_t index=0;
+            for (int b=n-1; b>=0; --b) {
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    const Translation t=(l>n) ? (key.translation()[d]>>(l-n)) : (key.translation()[d]<<(n-l));
+                    index=(index<<1) | ((t>>b) & 0x1);
+                }
+            }
+            return index;
+        }
+
+        /// Returns the boundaries of equally long segments of the curve
+        static std::vector<uint64_t> uniform_cuts(const int nproc, const Level n) {
+            const uint64_t nbox=uint64_t(1)<<(n*NDIM);
+            std::vector<uint64_t> cuts(std::max(nproc-1,0));
+            for (int p=1; p<nproc; ++p) cuts[p-1]=(nbox/nproc)*p + std::min(uint64_t(p),nbox%nproc);
+            return cuts;
+        }
+
+        /// Makes equally long segments of the curve for \c nproc processes
+        SFCPmap(const int nproc, const Level n) : level(n), cuts(uniform_cuts(nproc,n)) {
+            MADNESS_ASSERT(level*NDIM<=std::size_t(max_bits()));
+        }
+
+        /// Makes equally long segments of the curve for all processes
+        SFCPmap(World& world)
+            : level(default_level(world.size()))
+            , cuts(uniform_cuts(world.size(),level)) {
+        }
+
+        /// Makes segments with given boundaries
+
+        /// @param[in]  n       the partition level
+        /// @param[in]  cuts    cuts[p] is the first curve index owned by process p+1 (nproc-1 entries)
+        SFCPmap(const Level n, const std::vector<uint64_t>& cuts) : level(n), cuts(cuts) {
+            MADNESS_ASSERT(level*NDIM<=std::size_t(max_bits()));
+        }
+
+        /// Returns the partition level
+        Level get_level() const {return level;}
+
+        /// Returns the segment boundaries
+        const std::vector<uint64_t>& get_cuts() const {return cuts;}
+
+        /// Find the owner of a given key
+        ProcessID owner(const keyT& key) const {
+            const uint64_t index=curve_index(key,level);
+            return std::upper_bound(cuts.begin(),cuts.end(),index)-cuts.begin();
+        }
+
+        void print() const {
+            madness::print("SFCPmap: level",level,"cuts",cuts);
+        }
+    };
+
+
+    /// Optional accounting of the measured cpu time per key
+
+    /// When enabled, the tasks of apply, multiplication and compress add the
+    /// time they spend on a node to a process-local table indexed by the key
+    /// that was processed.  The table is not distributed and is not
+    /// communicated; LoadBalanceDeux::add_measured_cost sends its entries
+    /// into the tree of costs instead of (or on top of) a cost model.
+    /// Accounting is off by default and costs a single test per task then.
+    template <std::size_t NDIM>
+    class MeasuredCost {
+        typedef Key<NDIM> keyT;
+        typedef ConcurrentHashMap<keyT,double> tableT;
+
+        static tableT& table() {
+            static tableT t;
+            return t;
+        }
+
+        static volatile bool& flag() {
+            static volatile bool on=false;
+            return on;
+        }
+
+    public:
+        typedef typename tableT::const_iterator const_iterator;
+
+        /// Times the lifetime of this object and adds it to the key
+        class timer {
+            const keyT key;
+            const double cpu0;
+        public:
+            timer(const keyT& key) : key(key), cpu0(enabled() ? cpu_time() : 0.0) {}
+            ~timer() {
+                if (cpu0!=0.0) MeasuredCost<NDIM>::add(key,cpu_time()-cpu0);
+            }
+        };
+
+        /// Switches the accounting on or off; must be called by all processes alike
+        static void enable(bool on=true) {flag()=on;}
+
+        static bool enabled() {return flag();}
+
+        /// Adds time to the cost of the key
+        static void add(const keyT& key, double t) {
+            typename tableT::accessor acc;
+            table().insert(acc,key);
+            acc->second+=t;
+        }
+
+        /// Returns the measured time of the key on this process
+        static double get(const keyT& key) {
+            typename tableT::const_accessor acc;
+            return table().find(acc,key) ? acc->second : 0.0;
+        }
+
+        /// Returns the measured time of all keys on this process
+        static double local_total() {
+            double sum=0.0;
+            for (const_iterator it=begin(); it!=end(); ++it) sum+=it->second;
+            return sum;
+        }
+
+        /// Returns the measured time per process
+        static std::vector<double> cost_per_proc(World& world) {
+            std::vector<double> proccost(world.size(),0.0);
+            proccost[world.rank()]=local_total();
+            world.gop.sum(&proccost[0],proccost.size());
+            return proccost;
+        }
+
+        static const_iterator begin() {return const_cast<const tableT&>(table()).begin();}
+        static const_iterator end() {return const_cast<const tableT&>(table()).end();}
+
+        /// Forgets all measurements on this process
+        static void clear() {table().clear();}
+    };
+
+
     template <std::size_t NDIM>
     class LBNodeDeux {
         static const int nchild = (1<<NDIM);
@@ -146,6 +309,11 @@ namespace madness {
             return total_cost;
         }
 
+        /// Returns the cost of this node without its children
+        double get_my_cost() const {
+            return my_cost;
+        }
+
         /// Accumulates cost into this node
         Void add(double cost, bool got_kids) {
             total_cost = (my_cost += cost);
@@ -289,6 +457,61 @@ namespace madness {
             const_cast<Function<T,NDIM>&>(f).unaryop_node(add_op<T,costT>(this,costfn), fence);
         }
 
+        /// Accumulates the cost measured by MeasuredCost on this process
+
+        /// Every process sends its own measurements, so this is collective if
+        /// fence is true.  Call it after add_tree, so that the structure of
+        /// the tree is known; the cost model can be zero to balance on the
+        /// measured cost alone.  Keys that are not in the tree do not
+        /// contribute to the cost of their ancestors.
+        /// @param[in]  scale   the measured times are multiplied by scale
+        /// @param[in]  fence   fence after sending the cost
+        void add_measured_cost(double scale=1.0, bool fence=false) {
+            typedef typename MeasuredCost<NDIM>::const_iterator citerT;
+            for (citerT it=MeasuredCost<NDIM>::begin(); it!=MeasuredCost<NDIM>::end(); ++it) {
+                tree.send(it->first, &nodeT::add, scale*it->second, false);
+            }
+            if (fence) world.gop.fence();
+        }
+
+        /// Returns the cost per process predicted by the tree for the given map
+        std::vector<double> cost_per_proc(const std::shared_ptr< WorldDCPmapInterface<keyT> >& pmap, int nproc=0) {
+            world.gop.fence();
+            if (nproc==0) nproc=world.size();
+            std::vector<double> proccost(nproc,0.0);
+            const_iteratorT end = tree.end();
+            for (const_iteratorT it=tree.begin(); it!=end; ++it) {
+                proccost[pmap->owner(it->first)] += it->second.get_my_cost();
+            }
+            world.gop.sum(&proccost[0],nproc);
+            return proccost;
+        }
+
+        /// Prints the predicted versus the measured share of the cost per process
+
+        /// The prediction is the cost in the tree for the given map, usually the
+        /// one the measurements were made with; the measured cost is the time
+        /// accumulated by MeasuredCost on each process.  Both are normalized to
+        /// their total, since the cost model is not in seconds.
+        void print_cost_per_proc(const std::shared_ptr< WorldDCPmapInterface<keyT> >& pmap) {
+            const std::vector<double> predicted=cost_per_proc(pmap);
+            const std::vector<double> measured=MeasuredCost<NDIM>::cost_per_proc(world);
+            if (world.rank()==0) {
+                double psum=0.0, msum=0.0;
+                for (int p=0; p<world.size(); ++p) {
+                    psum+=predicted[p];
+                    msum+=measured[p];
+                }
+                if (psum==0.0) psum=1.0;
+                if (msum==0.0) msum=1.0;
+                printf("  rank   predicted   measured   measured (s)\n");
+                for (int p=0; p<world.size(); ++p) {
+                    printf("%6d %11.4f %10.4f %14.4f\n", p, predicted[p]/psum, measured[p]/msum, measured[p]);
+                }
+                print("imbalance (max/avg cost): predicted",imbalance(predicted),"measured",imbalance(measured));
+            }
+        }
+
         /// Printing for the curious
         void print_tree(const keyT& key = keyT(0)) {
             Future<iteratorT> futit = tree.find(key);
@@ -393,6 +616,149 @@ namespace madness {
 
             return std::shared_ptr< WorldDCPmapInterface<keyT> >(new LBDeuxPmap<NDIM>(map));
         }
+
+        /// Returns the global cost of all boxes on the partition level in curve order
+
+        /// The cost of each node is attributed to its box on the partition
+        /// level; every process bins its local nodes, and the bins are summed
+        /// up globally, so that no process needs to see the whole tree.
+        std::vector<double> sfc_box_costs(const Level level) {
+            world.gop.fence();
+            const uint64_t nbox=uint64_t(1)<<(level*NDIM);
+            std::vector<double> cost(nbox,0.0);
+            const_iteratorT end = tree.end();
+            for (const_iteratorT it=tree.begin(); it!=end; ++it) {
+                const double c=it->second.get_my_cost();
+                if (c>0.0) cost[SFCPmap<NDIM>::curve_index(it->first,level)] += c;
+            }
+            world.gop.sum(&cost[0],nbox);
+            return cost;
+        }
+
+        /// Cuts the curve into nproc segments of about equal cost using the prefix sums of the box costs
+        static std::vector<uint64_t> sfc_cuts(const std::vector<double>& cost, const int nproc) {
+            double total=0.0;
+            for (std::size_t i=0; i<cost.size(); ++i) total+=cost[i];
+
+            // Cut before the box that takes the running sum across the next target
+            std::vector<uint64_t> cuts(nproc-1,cost.size());
+            double sum=0.0;
+            int p=0;
+            for (std::size_t i=0; i<cost.size() and p<nproc-1; ++i) {
+                while (p<nproc-1 and sum+0.5*cost[i] > total*(p+1)/nproc) cuts[p++]=i;
+                sum+=cost[i];
+            }
+            return cuts;
+        }
+
+        /// Returns the cost per process for the given segment boundaries
+        static std::vector<double> sfc_cost_per_proc(const std::vector<double>& cost,
+                const std::vector<uint64_t>& cuts) {
+            std::vector<double> proccost(cuts.size()+1,0.0);
+            int p=0;
+            for (std::size_t i=0; i<cost.size(); ++i) {
+                while (p<int(cuts.size()) and i>=cuts[p]) ++p;
+                proccost[p]+=cost[i];
+            }
+            return proccost;
+        }
+
+        /// Returns the ratio of the maximum to the average cost per process
+        static double imbalance(const std::vector<double>& proccost) {
+            double sum=0.0, max=0.0;
+            for (std::size_t p=0; p<proccost.size(); ++p) {
+                sum+=proccost[p];
+                max=std::max(max,proccost[p]);
+            }
+            return (sum>0.0) ? max*proccost.size()/sum : 1.0;
+        }
+
+        /// Returns the fraction of the cost whose owner differs between two sets of boundaries
+        static double moved_fraction(const std::vector<double>& cost,
+                const std::vector<uint64_t>& cuts0, const std::vector<uint64_t>& cuts1) {
+            double total=0.0, moved=0.0;
+            for (std::size_t i=0; i<cost.size(); ++i) {
+                total+=cost[i];
+                const long p0=std::upper_bound(cuts0.begin(),cuts0.end(),i)-cuts0.begin();
+                const long p1=std::upper_bound(cuts1.begin(),cuts1.end(),i)-cuts1.begin();
+                if (p0!=p1) moved+=cost[i];
+            }
+            return (total>0.0) ? moved/total : 0.0;
+        }
+
+        /// The maximum number of boxes (as a power of 2) used for the automatic choice of the partition level
+        static int max_sfc_bits() {return 21;}
+
+        /// Partitions the space-filling curve into segments of equal cost
+
+        /// The box costs are summed up in parallel and every process computes
+        /// the same segment boundaries from their prefix sums.  The tree of
+        /// costs need not be summed.  The memory is proportional to the number
+        /// of boxes on the partition level, the resulting map needs nproc-1 words.
+        /// If no level is given the partition level is refined, starting from
+        /// the default level, until the imbalance is below 1+tol or the number
+        /// of boxes reaches 2^max_sfc_bits().
+        /// @param[in]  level   the partition level, 0 for automatic choice
+        /// @param[in]  nproc   the number of segments, 0 for the number of processes
+        /// @param[in]  printstuff  print the imbalance of the new map
+        /// @param[in]  tol     the tolerated imbalance for the automatic choice of the level
+        /// @return     a SFCPmap
+        std::shared_ptr< WorldDCPmapInterface<keyT> > load_balance_sfc(Level level=0, int nproc=0,
+                bool printstuff=false, double tol=0.1) {
+            if (nproc==0) nproc=world.size();
+            const bool automatic=(level==0);
+            if (automatic) level=SFCPmap<NDIM>::default_level(nproc);
+
+            std::vector<double> cost=sfc_box_costs(level);
+            std::vector<uint64_t> cuts=sfc_cuts(cost,nproc);
+            double imb=imbalance(sfc_cost_per_proc(cost,cuts));
+            while (automatic and imb>1.0+tol and (level+1)*NDIM<=std::size_t(max_sfc_bits())) {
+                ++level;
+                cost=sfc_box_costs(level);
+                cuts=sfc_cuts(cost,nproc);
+                imb=imbalance(sfc_cost_per_proc(cost,cuts));
+            }
+            if (printstuff and world.rank()==0) {
+                print("load_balance_sfc: level",level,"imbalance (max/avg cost)",imb);
+            }
+            return std::shared_ptr< WorldDCPmapInterface<keyT> >(new SFCPmap<NDIM>(level,cuts));
+        }
+
+        /// Incrementally rebalances a map from load_balance_sfc
+
+        /// The current map is kept if its imbalance (max/avg cost per process)
+        /// is below 1+tol.  Otherwise the segment boundaries are moved to the
+        /// new prefix-sum cuts; since the segments are contiguous on the curve
+        /// only the subtrees next to the boundaries change their owner.
+        /// If the current map is not a SFCPmap a new one is made.
+        /// @param[in]  current the current map
+        /// @param[in]  tol     the tolerated imbalance
+        /// @param[in]  printstuff  print the imbalance before and after, and the moved cost
+        /// @return     the current or a new SFCPmap
+        std::shared_ptr< WorldDCPmapInterface<keyT> >
+        rebalance_sfc(const std::shared_ptr< WorldDCPmapInterface<keyT> >& current, double tol=0.1,
+                bool printstuff=false) {
+            const SFCPmap<NDIM>* sfc=dynamic_cast<const SFCPmap<NDIM>*>(current.get());
+            const int nproc=world.size();
+            if ((not sfc) or (int(sfc->get_cuts().size())!=nproc-1)) return load_balance_sfc(0,0,printstuff);
+
+            const Level level=sfc->get_level();
+            const std::vector<double> cost=sfc_box_costs(level);
+            const double before=imbalance(sfc_cost_per_proc(cost,sfc->get_cuts()));
+            if (before<=1.0+tol) {
+                if (printstuff and world.rank()==0) {
+                    print("rebalance_sfc: imbalance",before,"is within tolerance, keeping the map");
+                }
+                return current;
+            }
+
+            const std::vector<uint64_t> cuts=sfc_cuts(cost,nproc);
+            if (printstuff and world.rank()==0) {
+                print("rebalance_sfc: imbalance",before,"->",imbalance(sfc_cost_per_proc(cost,cuts)),
+                      "moved cost fraction",moved_fraction(cost,sfc->get_cuts(),cuts));
+            }
+            return std::shared_ptr< WorldDCPmapInterface<keyT> >(new SFCPmap<NDIM>(level,cuts));
+        }
     };
 }
 
@@ -212,6 +212,43 @@ namespace madness {
             return result;
         }
 
+        /// Evaluates the function at many points in user coordinates.  Possible non-blocking comm.
+
+        /// Only the invoking process will receive the values, in the order of
+        /// the points.  The points are evaluated leaf by leaf and sent with one
+        /// message per process, which is much faster than calling eval() for
+        /// each point.
+        ///
+        /// Throws if function is not initialized.
+        Future< std::vector<T> > eval_points(const std::vector<coordT>& xuser) const {
+            PROFILE_MEMBER_FUNC(Function);
+            const double eps=1e-15;
+            verify();
+            MADNESS_ASSERT(!is_compressed());
+            std::vector<coordT> xsim(xuser.size());
+            for (std::size_t i=0; i<xuser.size(); ++i) {
+                user_to_sim(xuser[i],xsim[i]);
+                // If on the boundary, move the point just inside the
+                // volume so that the evaluation logic does not fail
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    if (xsim[i][d] < -eps) {
+                        MADNESS_EXCEPTION("eval: coordinate lower-bound error in dimension", d);
+                    }
+                    else if (xsim[i][d] < eps) {
+                        xsim[i][d] = eps;
+                    }
+
+                    if (xsim[i][d] > 1.0+eps) {
+                        MADNESS_EXCEPTION("eval: coordinate upper-bound error in dimension", d);
+                    }
+                    else if (xsim[i][d] > 1.0-eps) {
+                        xsim[i][d] = 1.0-eps;
+                    }
+                }
+            }
+            return impl->eval_points(xsim, std::vector< Key<NDIM> >(xsim.size(), impl->key0()));
+        }
+
         /// Evaluate function only if point is local returning (true,value); otherwise return (false,0.0)
 
         /// maxlevel is the maximum depth to search down to --- the max local depth can be
@@ -356,6 +393,43 @@ namespace madness {
             return impl->eval_plot_cube(simlo, simhi, npt, eval_refine);
         }
 
+        /// Evaluates the points of a cube/slice in the local leaf boxes ... collective but no communication
+
+        /// Unlike eval_cube no process holds the entire result.  Every process
+        /// returns the values at the points in its own leaf boxes, one block
+        /// per box together with the index of its first point; the blocks of
+        /// all processes together cover the cube.
+        /// @param[in] cell A Tensor describe the cube where the function to be evaluated in
+        /// @param[in] npt How many points to evaluate in each dimension
+        std::vector< std::pair< Vector<long,NDIM>, Tensor<T> > >
+        eval_cube_local(const Tensor<double>& cell, const std::vector<long>& npt) const {
+            MADNESS_ASSERT(static_cast<std::size_t>(cell.dim(0))>=NDIM && cell.dim(1)==2 && npt.size()>=NDIM);
+            PROFILE_MEMBER_FUNC(Function);
+            const double eps=1e-14;
+            verify();
+            reconstruct();
+            coordT simlo, simhi;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                simlo[d] = cell(d,0);
+                simhi[d] = cell(d,1);
+            }
+            user_to_sim(simlo, simlo);
+            user_to_sim(simhi, simhi);
+
+            // Move the bounding box infintesimally inside dyadic
+            // points so that the evaluation logic does not fail
+            for (std::size_t d=0; d<NDIM; ++d) {
+                MADNESS_ASSERT(simhi[d] >= simlo[d]);
+                MADNESS_ASSERT(simlo[d] >= 0.0);
+                MADNESS_ASSERT(simhi[d] <= 1.0);
+
+                double delta = eps*(simhi[d]-simlo[d]);
+                simlo[d] += delta;
+                simhi[d] -= 2*delta;  // deliberate asymmetry
+            }
+            return impl->eval_plot_boxes(simlo, simhi, npt);
+        }
+
 
         /// Evaluates the function at a point in user coordinates.  Collective operation.
 
@@ -585,6 +659,26 @@ namespace madness {
         }
 
 
+        /// Truncate only the parts of the function modified since its last truncation
+
+        /// Revisits the modified nodes and their paths to the root only; the result
+        /// is the same as truncate().  Falls back to truncate() if the function was
+        /// reconstructed or last truncated with a different tolerance.
+        ///
+        /// Returns this for chaining.
+        /// @param[in] tol Tolerance for truncating the coefficients. Default 0.0 means use the implimentation's member value \c thresh instead.
+        /// @param[in] fence Do fence
+        Function<T,NDIM>& truncate_incremental(double tol = 0.0, bool fence = true) {
+            PROFILE_MEMBER_FUNC(Function);
+            if (!impl) return *this;
+            verify();
+            if (!is_compressed()) compress();
+            impl->truncate_incremental(tol,fence);
+            if (VERIFY_TREE) verify_tree();
+            return *this;
+        }
+
+
         /// Returns a shared-pointer to the implementation
         const std::shared_ptr< FunctionImpl<T,NDIM> >& get_impl() const {
             PROFILE_MEMBER_FUNC(Function);
@@ -669,6 +763,16 @@ namespace madness {
         }
 
 
+        /// Updates the norm_tree information only on the paths to nodes modified since the last update
+        void norm_tree_incremental(bool fence = true) const {
+            PROFILE_MEMBER_FUNC(Function);
+            verify();
+            if (VERIFY_TREE) verify_tree();
+            if (is_compressed()) reconstruct();
+            const_cast<Function<T,NDIM>*>(this)->impl->norm_tree_incremental(fence);
+        }
+
+
         /// Compresses the function, transforming into wavelet basis.  Possible non-blocking comm.
 
         /// By default fence=true meaning that this operation completes before returning,
@@ -1379,6 +1483,21 @@ namespace madness {
             return *this;
         }
 
+        /// Like multiop_values, but op is applied to batches of nbatch boxes at a time ... private
+        template <typename opT>
+        Function<T,NDIM>& multiop_values_batched(const opT& op, const std::vector< Function<T,NDIM> >& vf,
+                                                 const std::size_t nbatch) {
+            std::vector<implT*> v(vf.size());
+            for (unsigned int i=0; i<v.size(); ++i) {
+                v[i] = vf[i].get_impl().get();
+            }
+            impl->multiop_values_batched(op, v, nbatch);
+            world().gop.fence();
+            if (VERIFY_TREE) verify_tree();
+
+            return *this;
+        }
+
         /// Multiplication of function * vector of functions using recursive algorithm of mulxx
         template <typename L, typename R>
         void vmulXX(const Function<L,NDIM>& left,
@@ -1477,6 +1596,27 @@ namespace madness {
             impl->reduce_rank(impl->get_tensor_args(),fence);
             return *this;
         }
+
+        /// Store the coefficients in single precision where the truncation threshold allows
+
+        /// The rounding error of each node is kept below 0.1*truncate_tol, so
+        /// that most of the difference coefficients of a compressed function
+        /// (and the fine scale coefficients of a reconstructed one) take half
+        /// the memory.  A compact function is for storage only: norm2, and
+        /// inner with a function in the same compressed state, promote the
+        /// coefficients on the fly; everything else requires expand() first.
+        Function<T,NDIM>& compact(const bool fence=true) {
+            verify();
+            impl->compact(fence);
+            return *this;
+        }
+
+        /// Restore the coefficients in full precision after compact()
+        Function<T,NDIM>& expand(const bool fence=true) {
+            verify();
+            impl->expand(fence);
+            return *this;
+        }
     };
 
     template <typename T, typename opT, int NDIM>
@@ -1487,6 +1627,23 @@ namespace madness {
         return r;
     }
 
+    /// Apply a pointwise op to the values of several functions, many boxes per call
+
+    /// The functions must be reconstructed and refined to a common level, as
+    /// for multiop_values.  The values of up to nbatch boxes are stacked along
+    /// the first dimension of the tensors passed to op, which must therefore
+    /// act pointwise and return a tensor of the same shape; the key passed
+    /// to op is that of the first box in the batch.  Amortizes the per-call
+    /// overhead of expensive pointwise kernels such as XC functionals.
+    template <typename T, typename opT, int NDIM>
+    Function<T,NDIM> multiop_values_batched(const opT& op, const std::vector< Function<T,NDIM> >& vf,
+                                            const std::size_t nbatch=64) {
+        Function<T,NDIM> r;
+        r.set_impl(vf[0], false);
+        r.multiop_values_batched(op, vf, nbatch);
+        return r;
+    }
+
     /// Returns new function equal to alpha*f(x) with optional fence
     template <typename Q, typename T, std::size_t NDIM>
     Function<TENSOR_RESULT_TYPE(Q,T),NDIM>
@@ -1545,6 +1702,44 @@ namespace madness {
         return result;
     }
 
+    /// Sparse multiplication with the truncation fused into the product
+
+    /// Gives the same result as mul_sparse followed by truncate(tol), but the
+    /// product nodes that truncation would remove are not created, so the
+    /// product never grows beyond its truncated size.  The operands are
+    /// reconstructed, get their norm_tree and are made redundant during the
+    /// multiplication, which costs one compression each.
+    /// @param[in]  tol     truncation threshold of the product
+    template <typename L, typename R,std::size_t NDIM>
+    Function<TENSOR_RESULT_TYPE(L,R),NDIM>
+    mul_truncate(const Function<L,NDIM>& left, const Function<R,NDIM>& right, double tol, bool fence=true) {
+        PROFILE_FUNC;
+        left.verify();
+        right.verify();
+        World& world = left.world();
+        if (tol <= 0.0) tol = left.thresh();
+        const bool same = (left.get_impl() == right.get_impl());
+        left.reconstruct(false);
+        if (not same) right.reconstruct(false);
+        world.gop.fence();
+        left.norm_tree(false);
+        if (not same) right.norm_tree(false);
+        world.gop.fence();
+
+        // result takes the tree state of left, so create it before left is made redundant
+        Function<TENSOR_RESULT_TYPE(L,R),NDIM> result;
+        result.set_impl(left, false);
+        left.get_impl()->make_redundant(false);
+        if (not same) right.get_impl()->make_redundant(false);
+        world.gop.fence();
+        result.get_impl()->mulXX_truncate(left.get_impl().get(), right.get_impl().get(), tol, true);
+
+        left.get_impl()->undo_redundant(false);
+        if (not same) right.get_impl()->undo_redundant(false);
+        if (fence) world.gop.fence();
+        return result;
+    }
+
     /// Same as \c operator* but with optional fence and no automatic reconstruction
     template <typename L, typename R,std::size_t NDIM>
     Function<TENSOR_RESULT_TYPE(L,R),NDIM>
@@ -1960,7 +2155,7 @@ namespace madness {
 
     		MADNESS_ASSERT(not op.is_slaterf12);
     	    ff.get_impl()->make_redundant(true);
-            result = apply_only(op, ff, fence);
+            result = apply_only(op, ff, true);
             ff.get_impl()->undo_redundant(false);
             result.get_impl()->trickle_down(true);
 
@@ -1982,7 +2177,7 @@ namespace madness {
                 fff.get_impl()->timer_filter.print("filter");
                 fff.get_impl()->timer_compress_svd.print("compress_svd");
             }
-            result = apply_only(op, fff, fence);
+            result = apply_only(op, fff, true);
             result.reconstruct();
 //            fff.clear();
             if (op.destructive()) {
@@ -314,6 +314,7 @@ namespace madness {
             timer_accumulate.print("accumulate");
             timer_target_driven.print("target_driven");
             timer_lr_result.print("result2low_rank");
+            print("apply buffer: results, sent",int(apply_buffer_nresult),int(apply_buffer_nsend));
         }
     }
     
@@ -323,6 +324,8 @@ namespace madness {
             timer_accumulate.reset();
             timer_target_driven.reset();
             timer_lr_result.reset();
+            apply_buffer_nresult=0;
+            apply_buffer_nsend=0;
         }
     }
     
@@ -336,14 +339,60 @@ namespace madness {
             tol = thresh;
         if (world.rank() == coeffs.owner(cdata.key0)) {
             if (is_compressed()) {
-                truncate_spawn(cdata.key0,tol);
+                truncate_spawn(cdata.key0,tol,false);
             } else {
                 truncate_reconstructed_spawn(cdata.key0,tol);
             }
         }
+        last_truncate_tol = is_compressed() ? tol : -1.0;
         if (fence)
             world.gop.fence();
     }
+
+    /// Truncate only the subtrees modified since the last truncation of the compressed tree
+
+    /// Truncation of an unmodified subtree with the same tolerance leaves
+    /// it unchanged, so only the nodes flagged by DIRTY_TRUNCATE and their
+    /// ancestors are revisited.
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::truncate_incremental(double tol, bool fence) {
+        if (tol <= 0.0)
+            tol = thresh;
+        if ((not is_compressed()) or (tol != last_truncate_tol)) {
+            truncate(tol,fence);
+            return;
+        }
+        propagate_dirty(nodeT::DIRTY_TRUNCATE,true);
+        if (world.rank() == coeffs.owner(cdata.key0))
+            truncate_spawn(cdata.key0,tol,true);
+        if (fence)
+            world.gop.fence();
+    }
+
+    /// mark the parents of all local nodes with any of the flags as dirty, up to the root
+
+    /// Node mutators only flag the node itself; the incremental passes
+    /// walk down from the root and need the flag on the whole path.
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::propagate_dirty(unsigned char flags, bool fence) {
+        typename dcT::const_iterator end = coeffs.end();
+        for (typename dcT::const_iterator it=coeffs.begin(); it!=end; ++it) {
+            const keyT& key = it->first;
+            if (it->second.is_dirty(flags) and key.level()>0) {
+                const keyT parent = key.parent();
+                coeffs.task(parent, &nodeT::set_dirty_recursive, coeffs, parent, flags);
+            }
+        }
+        if (fence)
+            world.gop.fence();
+    }
+
+    template <typename T, std::size_t NDIM>
+    long FunctionImpl<T,NDIM>::get_nodes_touched() const {
+        long n = nodes_touched;
+        world.gop.sum(n);
+        return n;
+    }
     
     template <typename T, std::size_t NDIM>
     const typename FunctionImpl<T,NDIM>::keyT& FunctionImpl<T,NDIM>::key0() const {
@@ -1182,6 +1231,18 @@ namespace madness {
     void FunctionImpl<T,NDIM>::reduce_rank(const TensorArgs& targs, bool fence) {
         flo_unary_op_node_inplace(do_reduce_rank(targs),fence);
     }
+
+    /// store the coefficients in reduced precision where the truncation threshold allows
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::compact(bool fence) {
+        flo_unary_op_node_inplace(do_compact(this),fence);
+    }
+
+    /// restore the coefficients in full precision after compact
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::expand(bool fence) {
+        flo_unary_op_node_inplace(do_expand(),fence);
+    }
     
     
     /// Transform sum coefficients at level n to sums+differences at level n-1
@@ -1526,7 +1587,17 @@ namespace madness {
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::norm_tree(bool fence) {
         if (world.rank() == coeffs.owner(cdata.key0))
-            norm_tree_spawn(cdata.key0);
+            norm_tree_spawn(cdata.key0,false);
+        if (fence)
+            world.gop.fence();
+    }
+
+    /// recompute norm_tree only on the paths to nodes modified since the last pass
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::norm_tree_incremental(bool fence) {
+        propagate_dirty(nodeT::DIRTY_NORM_TREE,true);
+        if (world.rank() == coeffs.owner(cdata.key0))
+            norm_tree_spawn(cdata.key0,true);
         if (fence)
             world.gop.fence();
     }
@@ -1541,27 +1612,31 @@ namespace madness {
             sum += value*value;
         }
         sum = sqrt(sum);
-        coeffs.task(key, &nodeT::set_norm_tree, sum); // why a task? because send is deprecated to keep comm thread free
+        coeffs.task(key, &nodeT::update_norm_tree, sum); // why a task? because send is deprecated to keep comm thread free
         //if (key.level() == 0) std::cout << "NORM_TREE_TOP " << sum << "\n";
         return sum;
     }
     
     template <typename T, std::size_t NDIM>
-    Future<double> FunctionImpl<T,NDIM>::norm_tree_spawn(const keyT& key) {
+    Future<double> FunctionImpl<T,NDIM>::norm_tree_spawn(const keyT& key, bool incremental) {
         nodeT& node = coeffs.find(key).get()->second;
+        if (incremental and not node.is_dirty(nodeT::DIRTY_NORM_TREE))
+            return Future<double>(node.get_norm_tree());
+        nodes_touched++;
         if (node.has_children()) {
             std::vector< Future<double> > v = future_vector_factory<double>(1<<NDIM);
             int i=0;
             for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::norm_tree_spawn, kit.key());
+                v[i] = woT::task(coeffs.owner(kit.key()), &implT::norm_tree_spawn, kit.key(), incremental);
             }
             return woT::task(world.rank(),&implT::norm_tree_op, key, v);
         }
         else {
-            //                return Future<double>(node.coeff().normf());
-            const double norm=node.coeff().normf();
+            // const access, so that the node is not flagged as modified
+            const nodeT& cnode = node;
+            const double norm=cnode.coeff().normf();
             // invoked locally anyways
-            node.set_norm_tree(norm);
+            node.update_norm_tree(norm);
             return Future<double>(norm);
         }
     }
@@ -1664,6 +1739,7 @@ namespace madness {
         PROFILE_MEMBER_FUNC(FunctionImpl);
         
         MADNESS_ASSERT(not redundant);
+        typename MeasuredCost<NDIM>::timer timer(key);
         double cpu0=cpu_time();
         // Copy child scaling coeffs into contiguous block
         tensorT d(cdata.v2k);
@@ -1731,14 +1807,49 @@ namespace madness {
         targs2.thresh*=0.1;
         coeffT s(this->downsample(key,v),targs2);
         
-        // insert sum coefficients into tree
+        // insert sum coefficients into tree, replacing outdated ones in incremental updates
         typename dcT::accessor acc;
         MADNESS_ASSERT(coeffs.find(acc, key));
-        MADNESS_ASSERT(not (acc->second.has_coeff()));
         acc->second.set_coeff(s);
+        acc->second.clear_dirty(nodeT::DIRTY_REDUNDANT);
         
         return s;
     }
+
+    /// update the sum coefficients of a redundant tree on the paths to modified nodes
+
+    /// Falls back to make_redundant() if the function is not redundant.
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::make_redundant_incremental(const bool fence) {
+        if (not is_redundant()) {
+            make_redundant(fence);
+            return;
+        }
+        propagate_dirty(nodeT::DIRTY_REDUNDANT,true);
+        if (world.rank() == coeffs.owner(cdata.key0))
+            make_redundant_spawn(cdata.key0);
+        if (fence)
+            world.gop.fence();
+    }
+
+    template <typename T, std::size_t NDIM>
+    Future<typename FunctionImpl<T,NDIM>::coeffT> FunctionImpl<T,NDIM>::make_redundant_spawn(const keyT& key) {
+        nodeT& node = coeffs.find(key).get()->second;
+        const nodeT& cnode = node;
+        if (not node.is_dirty(nodeT::DIRTY_REDUNDANT))
+            return Future<coeffT>(cnode.coeff());
+        nodes_touched++;
+        if (node.has_children()) {
+            std::vector< Future<coeffT > > v = future_vector_factory<coeffT >(1<<NDIM);
+            int i=0;
+            for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
+                v[i] = woT::task(coeffs.owner(kit.key()), &implT::make_redundant_spawn, kit.key());
+            }
+            return woT::task(world.rank(),&implT::make_redundant_op, key, v);
+        }
+        node.clear_dirty(nodeT::DIRTY_REDUNDANT);
+        return Future<coeffT>(cnode.coeff());
+    }
     
     /// Changes non-standard compressed form to standard compressed form
     template <typename T, std::size_t NDIM>
@@ -1755,6 +1866,7 @@ namespace madness {
         TensorArgs tight_args(targs);
         tight_args.thresh*=0.01;
         double begin=wall_time();
+        flush_apply_buffer(true);
         flo_unary_op_node_inplace(do_consolidate_buffer(tight_args),true);
         
         // reduce the rank of the final nodes, leave full tensors unchanged
@@ -1875,7 +1987,7 @@ namespace madness {
         typename dcT::const_iterator end = coeffs.end();
         for (typename dcT::const_iterator it=coeffs.begin(); it!=end; ++it) {
             const nodeT& node = it->second;
-            if (node.has_coeff()) sum+=node.coeff().real_size();
+            sum+=node.real_size();
         }
         world.gop.sum(sum);
         return sum;
@@ -2039,7 +2151,11 @@ namespace madness {
                     coeffT ss = copy(d(child_patch(child)));
                     ss.reduce_rank(thresh);
                     //PROFILE_BLOCK(recon_send); // Too fine grain for routine profiling
-                    woT::task(coeffs.owner(child), &implT::reconstruct_op, child, ss);
+                    if (fuse_with_parent(child)) {
+                        reconstruct_op(child, ss);
+                    } else {
+                        woT::task(coeffs.owner(child), &implT::reconstruct_op, child, ss);
+                    }
                 }
             } else {
                 MADNESS_ASSERT(node.is_leaf());
@@ -2074,6 +2190,25 @@ namespace madness {
         return fval;
     }
     
+    namespace detail {
+        /// Returns the per-thread scratch buffer \c ibuf of at least \c size doubles
+
+        /// The buffers persist between calls of fcube, so projection does
+        /// not allocate per box.  Very large requests are not kept.
+        inline double* fcube_buffer(int ibuf, std::size_t size) {
+            static const std::size_t maxkeep = 1<<20;
+            static thread_local std::vector<double> buffer[2];
+            static thread_local std::vector<double> large[2];
+            if (size > maxkeep) {
+                large[ibuf].resize(size);
+                return &large[ibuf][0];
+            }
+            large[ibuf] = std::vector<double>();
+            if (buffer[ibuf].size() < size) buffer[ibuf].resize(size);
+            return &buffer[ibuf][0];
+        }
+    }
+
     /// return the values of a Function on a grid
     
     /// @param[in]  key the key indicating where the quadrature points are located
@@ -2107,169 +2242,34 @@ namespace madness {
             return;
         }
 
-        Tensor<double> vqx;
-        bool vectorized = f.supports_vectorized(); 
-        if (vectorized) {
-            T* fvptr = fval.ptr();
-            if (NDIM == 1) {
-                double* x1 = new double[npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i, ++idx) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    x1[idx] = c[0];
-                }
-                Vector<double*,1> xvals = vec(x1);
-                f(xvals, fvptr, npt);
-                delete [] x1;
-            }
-            else if (NDIM == 2) {
-                double* x1 = new double[npt*npt];
-                double* x2 = new double[npt*npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    for (int j=0; j<npt; ++j, ++idx) {
-                        c[1] = cell(1,0) + h*cell_width[1]*(l[1] + qx(j)); // y
-                        x1[idx] = c[0];
-                        x2[idx] = c[1];
-                    }
-                }
-                Vector<double*,2> xvals = vec(x1, x2);
-                f(xvals, fvptr, npt*npt);
-                delete [] x1;
-                delete [] x2;
-            }
-            else if (NDIM == 3) {
-                double* x1 = new double[npt*npt*npt];
-                double* x2 = new double[npt*npt*npt];
-                double* x3 = new double[npt*npt*npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    for (int j=0; j<npt; ++j) {
-                        c[1] = cell(1,0) + h*cell_width[1]*(l[1] + qx(j)); // y
-                        for (int k=0; k<npt; ++k, ++idx) {
-                            c[2] = cell(2,0) + h*cell_width[2]*(l[2] + qx(k)); // z
-                            x1[idx] = c[0];
-                            x2[idx] = c[1];
-                            x3[idx] = c[2];
-                        }
-                    }
-                }
-                Vector<double*,3> xvals = vec(x1, x2, x3);
-                f(xvals, fvptr, npt*npt*npt);
-                delete [] x1;
-                delete [] x2;
-                delete [] x3;
-            }
-            else if (NDIM == 4) {
-                double* x1 = new double[npt*npt*npt*npt];
-                double* x2 = new double[npt*npt*npt*npt];
-                double* x3 = new double[npt*npt*npt*npt];
-                double* x4 = new double[npt*npt*npt*npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    for (int j=0; j<npt; ++j) {
-                        c[1] = cell(1,0) + h*cell_width[1]*(l[1] + qx(j)); // y
-                        for (int k=0; k<npt; ++k) {
-                            c[2] = cell(2,0) + h*cell_width[2]*(l[2] + qx(k)); // z
-                            for (int m=0; m<npt; ++m, ++idx) {
-                                c[3] = cell(3,0) + h*cell_width[3]*(l[3] + qx(m)); // xx
-                                x1[idx] = c[0];
-                                x2[idx] = c[1];
-                                x3[idx] = c[2];
-                                x4[idx] = c[3];
-                            }
-                        }
-                    }
-                }
-                Vector<double*,4> xvals = vec(x1, x2, x3, x4);
-                f(xvals, fvptr, npt*npt*npt*npt);
-                delete [] x1;
-                delete [] x2;
-                delete [] x3;
-                delete [] x4;
-            }
-            else if (NDIM == 5) {
-                double* x1 = new double[npt*npt*npt*npt*npt];
-                double* x2 = new double[npt*npt*npt*npt*npt];
-                double* x3 = new double[npt*npt*npt*npt*npt];
-                double* x4 = new double[npt*npt*npt*npt*npt];
-                double* x5 = new double[npt*npt*npt*npt*npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    for (int j=0; j<npt; ++j) {
-                        c[1] = cell(1,0) + h*cell_width[1]*(l[1] + qx(j)); // y
-                        for (int k=0; k<npt; ++k) {
-                            c[2] = cell(2,0) + h*cell_width[2]*(l[2] + qx(k)); // z
-                            for (int m=0; m<npt; ++m) {
-                                c[3] = cell(3,0) + h*cell_width[3]*(l[3] + qx(m)); // xx
-                                for (int n=0; n<npt; ++n, ++idx) {
-                                    c[4] = cell(4,0) + h*cell_width[4]*(l[4] + qx(n)); // yy
-                                    x1[idx] = c[0];
-                                    x2[idx] = c[1];
-                                    x3[idx] = c[2];
-                                    x4[idx] = c[3];
-                                    x5[idx] = c[4];
-                                }
-                            }
-                        }
-                    }
-                }
-                Vector<double*,5> xvals = vec(x1, x2, x3, x4, x5);
-                f(xvals, fvptr, npt*npt*npt*npt*npt);
-                delete [] x1;
-                delete [] x2;
-                delete [] x3;
-                delete [] x4;
-                delete [] x5;
+        // the 1D quadrature points in user coordinates
+        double* x1d = detail::fcube_buffer(0, NDIM*npt);
+        for (std::size_t d=0; d<NDIM; ++d) {
+            for (int i=0; i<npt; ++i) {
+                x1d[d*npt+i] = cell(d,0) + h*cell_width[d]*(l[d] + qx(i));
             }
-            else if (NDIM == 6) {
-                double* x1 = new double[npt*npt*npt*npt*npt*npt];
-                double* x2 = new double[npt*npt*npt*npt*npt*npt];
-                double* x3 = new double[npt*npt*npt*npt*npt*npt];
-                double* x4 = new double[npt*npt*npt*npt*npt*npt];
-                double* x5 = new double[npt*npt*npt*npt*npt*npt];
-                double* x6 = new double[npt*npt*npt*npt*npt*npt];
-                int idx = 0;
-                for (int i=0; i<npt; ++i) {
-                    c[0] = cell(0,0) + h*cell_width[0]*(l[0] + qx(i)); // x
-                    for (int j=0; j<npt; ++j) {
-                        c[1] = cell(1,0) + h*cell_width[1]*(l[1] + qx(j)); // y
-                        for (int k=0; k<npt; ++k) {
-                            c[2] = cell(2,0) + h*cell_width[2]*(l[2] + qx(k)); // z
-                            for (int m=0; m<npt; ++m) {
-                                c[3] = cell(3,0) + h*cell_width[3]*(l[3] + qx(m)); // xx
-                                for (int n=0; n<npt; ++n) {
-                                    c[4] = cell(4,0) + h*cell_width[4]*(l[4] + qx(n)); // yy
-                                    for (int p=0; p<npt; ++p, ++idx) {
-                                        c[5] = cell(5,0) + h*cell_width[5]*(l[5] + qx(p)); // zz
-                                        x1[idx] = c[0];
-                                        x2[idx] = c[1];
-                                        x3[idx] = c[2];
-                                        x4[idx] = c[3];
-                                        x5[idx] = c[4];
-                                        x6[idx] = c[5];
-                                    }
-                                }
-                            }
-                        }
-                    }
+        }
+
+        if (f.supports_grid()) {
+            Vector<const double*,NDIM> xvals;
+            for (std::size_t d=0; d<NDIM; ++d) xvals[d] = x1d + d*npt;
+            f(xvals, npt, fval.ptr());
+        }
+        else if (f.supports_vectorized()) {
+            // expand the grid into per-dimension coordinate arrays, last dimension fastest
+            long npts = 1;
+            for (std::size_t d=0; d<NDIM; ++d) npts *= npt;
+            double* buf = detail::fcube_buffer(1, NDIM*npts);
+            Vector<double*,NDIM> xvals;
+            long stride = npts;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                xvals[d] = buf + d*npts;
+                stride /= npt;
+                for (long idx=0; idx<npts; ++idx) {
+                    xvals[d][idx] = x1d[d*npt + (idx/stride)%npt];
                 }
-                Vector<double*,6> xvals = vec(x1, x2, x3, x4, x5, x6);
-                f(xvals, fvptr, npt*npt*npt*npt*npt*npt);
-                delete [] x1;
-                delete [] x2;
-                delete [] x3;
-                delete [] x4;
-                delete [] x5;
-                delete [] x6;
-            }
-            else {
-                MADNESS_EXCEPTION("FunctionImpl: fcube: confused about NDIM?",NDIM);
             }
+            f(xvals, fval.ptr(), npts);
         }
         else {
             if (NDIM == 1) {
@@ -2529,7 +2529,7 @@ namespace madness {
     
     
     template <typename T, std::size_t NDIM>
-    Future<bool> FunctionImpl<T,NDIM>::truncate_spawn(const keyT& key, double tol) {
+    Future<bool> FunctionImpl<T,NDIM>::truncate_spawn(const keyT& key, double tol, bool incremental) {
         PROFILE_MEMBER_FUNC(FunctionImpl);
         typename dcT::iterator it = coeffs.find(key).get();
         if (it == coeffs.end()) {
@@ -2540,11 +2540,16 @@ namespace madness {
             it = coeffs.find(key).get();
         }
         nodeT& node = it->second;
+        const nodeT& cnode = node;
+        if (incremental and not node.is_dirty(nodeT::DIRTY_TRUNCATE))
+            return Future<bool>(node.has_coeff());
+        nodes_touched++;
         if (node.has_children()) {
             std::vector< Future<bool> > v = future_vector_factory<bool>(1<<NDIM);
             int i=0;
             for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::truncate_spawn, kit.key(), tol, TaskAttributes::generator());
+                v[i] = woT::task(coeffs.owner(kit.key()), &implT::truncate_spawn, kit.key(), tol, incremental,
+                                 TaskAttributes::generator());
             }
             return woT::task(world.rank(),&implT::truncate_op, key, tol, v);
         }
@@ -2554,11 +2559,12 @@ namespace madness {
             // in which case we want something sensible to happen
             //MADNESS_ASSERT(!node.has_coeff());
             if (node.has_coeff() && key.level()>1) {
-                double dnorm = node.coeff().normf();
+                double dnorm = cnode.coeff().normf();
                 if (dnorm < truncate_tol(tol,key)) {
                     node.clear_coeff();
                 }
             }
+            node.clear_dirty(nodeT::DIRTY_TRUNCATE);
             return Future<bool>(node.has_coeff());
         }
     }
@@ -2567,9 +2573,15 @@ namespace madness {
     template <typename T, std::size_t NDIM>
     bool FunctionImpl<T,NDIM>::truncate_op(const keyT& key, double tol, const std::vector< Future<bool> >& v) {
         //PROFILE_MEMBER_FUNC(FunctionImpl); // Too fine grain for routine profiling
-        // If any child has coefficients, a parent cannot truncate
-        for (int i=0; i<(1<<NDIM); ++i) if (v[i].get()) return true;
         nodeT& node = coeffs.find(key).get()->second;
+        const nodeT& cnode = node;
+        // If any child has coefficients, a parent cannot truncate
+        for (int i=0; i<(1<<NDIM); ++i) {
+            if (v[i].get()) {
+                node.clear_dirty(nodeT::DIRTY_TRUNCATE);
+                return true;
+            }
+        }
         
         // Interior nodes should always have coeffs but transform might
         // leave empty interior nodes ... hence just force no coeffs to
@@ -2577,7 +2589,7 @@ namespace madness {
         if (node.has_children() && !node.has_coeff()) node.set_coeff(coeffT(cdata.v2k,targs));
         
         if (key.level() > 1) { // >1 rather >0 otherwise reconstruct might get confused
-            double dnorm = node.coeff().normf();
+            double dnorm = cnode.coeff().normf();
             if (dnorm < truncate_tol(tol,key)) {
                 node.clear_coeff();
                 if (node.has_children()) {
@@ -2588,6 +2600,7 @@ namespace madness {
                 }
             }
         }
+        node.clear_dirty(nodeT::DIRTY_TRUNCATE);
         return node.has_coeff();
     }
     
@@ -2779,6 +2792,119 @@ namespace madness {
     }
     
     
+    template <typename T, std::size_t NDIM>
+    Future< std::vector<T> > FunctionImpl<T,NDIM>::eval_points(const std::vector<coordT>& x,
+                                                               const std::vector<keyT>& keyin) {
+        PROFILE_MEMBER_FUNC(FunctionImpl);
+        MADNESS_ASSERT(x.size() == keyin.size());
+        const ProcessID me = world.rank();
+        std::vector<T> values(x.size(), T(0.0));
+
+        // Walk each point down the local tree; collect the points per leaf
+        // and the points that continue elsewhere per process
+        typedef std::map< keyT, std::vector<std::size_t> > leafmapT;
+        typedef std::map< ProcessID, std::pair< std::vector<std::size_t>, std::vector<keyT> > > procmapT;
+        leafmapT leaves;
+        procmapT elsewhere;
+        for (std::size_t i=0; i<x.size(); ++i) {
+            keyT key = keyin[i];
+            while (1) {
+                if (coeffs.owner(key) != me) {
+                    std::pair< std::vector<std::size_t>, std::vector<keyT> >& e = elsewhere[coeffs.owner(key)];
+                    e.first.push_back(i);
+                    e.second.push_back(key);
+                    break;
+                }
+                typename dcT::iterator it = coeffs.find(key).get();
+                MADNESS_ASSERT(it != coeffs.end());
+                if (it->second.has_coeff()) {
+                    leaves[key].push_back(i);
+                    break;
+                }
+                const Level n = key.level()+1;
+                const double twon = double(Translation(1)<<n);
+                Vector<Translation,NDIM> l;
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    const Translation lo = 2*key.translation()[d];
+                    l[d] = std::min(std::max(Translation(x[i][d]*twon), lo), lo+1);
+                }
+                key = keyT(n,l);
+            }
+        }
+
+        for (typename leafmapT::const_iterator lit=leaves.begin(); lit!=leaves.end(); ++lit) {
+            typename dcT::iterator it = coeffs.find(lit->first).get();
+            eval_cube_points(lit->first, it->second.coeff().full_tensor_copy(), x, lit->second, values);
+        }
+
+        if (elsewhere.empty()) return Future< std::vector<T> >(values);
+
+        // One message per process, the values are merged when they are back
+        std::vector< std::vector<std::size_t> > index;
+        std::vector< Future< std::vector<T> > > remote;
+        for (typename procmapT::const_iterator pit=elsewhere.begin(); pit!=elsewhere.end(); ++pit) {
+            const std::vector<std::size_t>& idx = pit->second.first;
+            std::vector<coordT> xs(idx.size());
+            for (std::size_t j=0; j<idx.size(); ++j) xs[j] = x[idx[j]];
+            index.push_back(idx);
+            remote.push_back(woT::task(pit->first, &implT::eval_points, xs, pit->second.second,
+                                       TaskAttributes::hipri()));
+        }
+        return woT::task(me, &implT::eval_points_merge, values, index, remote, TaskAttributes::hipri());
+    }
+
+    template <typename T, std::size_t NDIM>
+    std::vector<T> FunctionImpl<T,NDIM>::eval_points_merge(const std::vector<T>& values,
+                                                           const std::vector< std::vector<std::size_t> >& index,
+                                                           const std::vector< Future< std::vector<T> > >& remote) const {
+        std::vector<T> result(values);
+        for (std::size_t p=0; p<remote.size(); ++p) {
+            const std::vector<T>& v = remote[p].get();
+            for (std::size_t j=0; j<v.size(); ++j) result[index[p][j]] = v[j];
+        }
+        return result;
+    }
+
+    template <typename T, std::size_t NDIM>
+    void FunctionImpl<T,NDIM>::eval_cube_points(const keyT& key, const tensorT& c, const std::vector<coordT>& x,
+                                                const std::vector<std::size_t>& index, std::vector<T>& values) const {
+        PROFILE_MEMBER_FUNC(FunctionImpl);
+        const long k = cdata.k;
+        const long m = index.size();
+        const double twon = double(Translation(1)<<key.level());
+
+        // p[d](i,q) is the polynomial q in dimension d at point i
+        Tensor<double> p[NDIM];
+        for (std::size_t d=0; d<NDIM; ++d) {
+            p[d] = Tensor<double>(m,k);
+            for (long i=0; i<m; ++i) {
+                legendre_scaling_functions(x[index[i]][d]*twon - key.translation()[d], k, &p[d](i,0));
+            }
+        }
+
+        // contract the first dimension for all points at once, then the others point by point
+        tensorT t = inner(p[0],c);
+        tensorT cur = t.reshape(m, t.size()/m);
+        for (std::size_t d=1; d<NDIM; ++d) {
+            const long s = cur.dim(1)/k;
+            tensorT next(m,s);
+            for (long i=0; i<m; ++i) {
+                const double* pi = p[d].ptr() + i*k;
+                const T* ci = cur.ptr() + i*cur.dim(1);
+                T* ni = next.ptr() + i*s;
+                for (long q=0; q<k; ++q) {
+                    const double pq = pi[q];
+                    const T* cq = ci + q*s;
+                    for (long j=0; j<s; ++j) ni[j] += pq*cq[j];
+                }
+            }
+            cur = next;
+        }
+
+        const double scale = pow(2.0,0.5*NDIM*key.level())/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
+        for (long i=0; i<m; ++i) values[index[i]] = cur(i,0)*scale;
+    }
+
     template <typename T, std::size_t NDIM>
     std::pair<bool,T>
     FunctionImpl<T,NDIM>::eval_local_only(const Vector<double,NDIM>& xin, Level maxlevel) {
@@ -3090,11 +3216,22 @@ namespace madness {
         if (node.has_children()) {
             std::vector< Future<coeffT > > v = future_vector_factory<coeffT >(1<<NDIM);
             int i=0;
+            bool ready=true;
             for (KeyChildIterator<NDIM> kit(key); kit; ++kit,++i) {
                 //PROFILE_BLOCK(compress_send); // Too fine grain for routine profiling
-                // readily available
-                v[i] = woT::task(coeffs.owner(kit.key()), &implT::compress_spawn, kit.key(),
-                                 nonstandard, keepleaves, redundant, TaskAttributes::hipri());
+                // walk local subtrees depth-first in this task, spawn tasks for the rest
+                if (fuse_with_parent(kit.key())) {
+                    v[i] = compress_spawn(kit.key(), nonstandard, keepleaves, redundant);
+                } else {
+                    v[i] = woT::task(coeffs.owner(kit.key()), &implT::compress_spawn, kit.key(),
+                                     nonstandard, keepleaves, redundant, TaskAttributes::hipri());
+                }
+                ready=ready and v[i].probe();
+            }
+            // all children are done: no need for another task
+            if (ready) {
+                if (redundant) return Future<coeffT >(make_redundant_op(key, v));
+                return Future<coeffT >(compress_op(key, v, nonstandard, redundant));
             }
             if (redundant) return woT::task(world.rank(),&implT::make_redundant_op, key, v);
             return woT::task(world.rank(),&implT::compress_op, key, v, nonstandard, redundant);
@@ -3102,18 +3239,15 @@ namespace madness {
         else {
             Future<coeffT > result(node.coeff());
             if (!keepleaves) node.clear_coeff();
+            if (redundant) node.clear_dirty(nodeT::DIRTY_REDUNDANT);
             return result;
         }
     }
     
     template <typename T, std::size_t NDIM>
-    Void FunctionImpl<T,NDIM>::plot_cube_kernel(archive::archive_ptr< Tensor<T> > ptr,
-                                                const keyT& key,
-                                                const coordT& plotlo, const coordT& plothi, const std::vector<long>& npt,
-                                                bool eval_refine) const {
-        
-        Tensor<T>& r = *ptr;
-        
+    Tensor<T> FunctionImpl<T,NDIM>::eval_plot_box(const keyT& key, const coordT& plotlo, const coordT& plothi,
+                                                  const std::vector<long>& npt, bool eval_refine,
+                                                  Vector<long,NDIM>& ilo) const {
         coordT h; // Increment between points in each dimension
         for (std::size_t i=0; i<NDIM; ++i) {
             if (npt[i] > 1) {
@@ -3124,28 +3258,23 @@ namespace madness {
                 h[i] = 0.0;
             }
         }
-        
+
         const Level n = key.level();
         const Vector<Translation,NDIM>& l = key.translation();
         const double twon = pow(2.0,double(n));
-        const tensorT& coeff = coeffs.find(key).get()->second.coeff().full_tensor_copy(); // Ugh!
-        //        const tensorT coeff = coeffs.find(key).get()->second.full_tensor_copy(); // Ugh!
-        long ind[NDIM];
-        coordT x;
-        
+
         coordT boxlo, boxhi;
-        Vector<int,NDIM> boxnpt;
+        long boxnpt[NDIM];
         double fac = pow(0.5,double(key.level()));
-        int npttotal = 1;
+        long npttotal = 1;
         for (std::size_t d=0; d<NDIM; ++d) {
             // Coords of box
             boxlo[d] = fac*key.translation()[d];
             boxhi[d] = boxlo[d]+fac;
-            
+
             if (boxlo[d] > plothi[d] || boxhi[d] < plotlo[d]) {
                 // Discard boxes out of the plot range
                 npttotal = boxnpt[d] = 0;
-                //print("OO range?");
                 break;
             }
             else if (npt[d] == 1) {
@@ -3157,50 +3286,104 @@ namespace madness {
                 // Restrict to plot range
                 boxlo[d] = std::max(boxlo[d],plotlo[d]);
                 boxhi[d] = std::min(boxhi[d],plothi[d]);
-                
+
                 // Round lo up to next plot point; round hi down
                 double xlo = long((boxlo[d]-plotlo[d])/h[d])*h[d] + plotlo[d];
                 if (xlo < boxlo[d]) xlo += h[d];
                 boxlo[d] =  xlo;
                 double xhi = long((boxhi[d]-plotlo[d])/h[d])*h[d] + plotlo[d];
                 if (xhi > boxhi[d]) xhi -= h[d];
-                // MADNESS_ASSERT(xhi >= xlo);  // nope
                 boxhi[d] = xhi;
                 boxnpt[d] = long(round((boxhi[d] - boxlo[d])/h[d])) + 1;
             }
+            if (boxnpt[d] <= 0) npttotal = 0;
             npttotal *= boxnpt[d];
         }
-        //print("    box", boxlo, boxhi, boxnpt, npttotal);
-        if (npttotal > 0) {
-            for (IndexIterator it(boxnpt); it; ++it) {
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    double xd = boxlo[d] + it[d]*h[d]; // Sim. coords of point
-                    x[d] = twon*xd - l[d]; // Offset within box
-                    MADNESS_ASSERT(x[d]>=0.0 && x[d] <=1.0);  // sanity
-                    if (npt[d] > 1) {
-                        ind[d] = long(round((xd-plotlo[d])/h[d])); // Index of plot point
-                    }
-                    else {
-                        ind[d] = 0;
-                    }
-                    MADNESS_ASSERT(ind[d]>=0 && ind[d]<npt[d]); // sanity
-                }
-                if (eval_refine) {
-                    r(ind) = n;
-                }
-                else {
-                    T tmp = eval_cube(n, x, coeff);
-                    r(ind) = tmp;
-                    //print("    eval", ind, tmp, r(ind));
-                }
+        if (npttotal <= 0) return Tensor<T>();
+
+        for (std::size_t d=0; d<NDIM; ++d) {
+            ilo[d] = (npt[d] > 1) ? long(round((boxlo[d]-plotlo[d])/h[d])) : 0;
+            MADNESS_ASSERT(ilo[d]>=0 && ilo[d]+boxnpt[d]<=npt[d]); // sanity
+        }
+
+        if (eval_refine) {
+            Tensor<T> r(NDIM, boxnpt);
+            r.fill(T(n));
+            return r;
+        }
+
+        // Transform the coefficients to the points one dimension at a time;
+        // each inner() cycles the contracted dimension to the end
+        const int k = cdata.k;
+        Tensor<T> r = coeffs.find(key).get()->second.coeff().full_tensor_copy();
+        for (std::size_t d=0; d<NDIM; ++d) {
+            Tensor<double> p(boxnpt[d],k);
+            for (long i=0; i<boxnpt[d]; ++i) {
+                double x = twon*(boxlo[d] + i*h[d]) - l[d]; // Offset within box
+                MADNESS_ASSERT(x>=0.0 && x<=1.0);  // sanity
+                legendre_scaling_functions(x, k, &p(i,0));
             }
+            r = inner(r,p,0,1);
         }
-        
+        r.scale(pow(2.0,0.5*NDIM*n)/sqrt(FunctionDefaults<NDIM>::get_cell_volume()));
+        return r;
+    }
+
+    template <typename T, std::size_t NDIM>
+    Void FunctionImpl<T,NDIM>::plot_cube_kernel(archive::archive_ptr< Tensor<T> > ptr,
+                                                const keyT& key,
+                                                const coordT& plotlo, const coordT& plothi, const std::vector<long>& npt,
+                                                bool eval_refine) const {
+
+        Tensor<T>& r = *ptr;
+        Vector<long,NDIM> ilo;
+        const Tensor<T> box = eval_plot_box(key, plotlo, plothi, npt, eval_refine, ilo);
+        if (box.size() > 0) {
+            std::vector<Slice> s(NDIM);
+            for (std::size_t d=0; d<NDIM; ++d) s[d] = Slice(ilo[d], ilo[d]+box.dim(d)-1);
+            r(s) = box;
+        }
+
         return None;
     }
-    
-    /// Set plot_refine=true to get a plot of the refinment levels of
-    /// the given function (defaulted to false in prototype).
+
+    template <typename T, std::size_t NDIM>
+    Void FunctionImpl<T,NDIM>::plot_box_kernel(archive::archive_ptr< std::vector<plotboxT> > ptr, long i,
+                                               const keyT& key, const coordT& plotlo, const coordT& plothi,
+                                               const std::vector<long>& npt) const {
+        plotboxT& box = (*ptr)[i];
+        box.second = eval_plot_box(key, plotlo, plothi, npt, false, box.first);
+        return None;
+    }
+
+    template <typename T, std::size_t NDIM>
+    std::vector<typename FunctionImpl<T,NDIM>::plotboxT>
+    FunctionImpl<T,NDIM>::eval_plot_boxes(const coordT& plotlo, const coordT& plothi,
+                                          const std::vector<long>& npt) const {
+        PROFILE_MEMBER_FUNC(FunctionImpl);
+        MADNESS_ASSERT(!compressed);
+
+        std::vector<keyT> leaves;
+        for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+            if (it->second.has_coeff()) leaves.push_back(it->first);
+        }
+
+        std::vector<plotboxT> boxes(leaves.size());
+        for (std::size_t i=0; i<leaves.size(); ++i) {
+            woT::task(world.rank(), &implT::plot_box_kernel,
+                      archive::archive_ptr< std::vector<plotboxT> >(&boxes), long(i), leaves[i], plotlo, plothi, npt);
+        }
+        world.taskq.fence();
+
+        // drop the boxes without plot points
+        std::size_t n=0;
+        for (std::size_t i=0; i<boxes.size(); ++i) {
+            if (boxes[i].second.size() > 0) boxes[n++] = boxes[i];
+        }
+        boxes.resize(n);
+        return boxes;
+    }
+
     template <typename T, std::size_t NDIM>
     Tensor<T> FunctionImpl<T,NDIM>::eval_plot_cube(const coordT& plotlo,
                                                    const coordT& plothi,
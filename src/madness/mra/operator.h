@@ -459,6 +459,78 @@ namespace madness {
         }
 
 
+        /// apply one separated term to many vectors at once, accumulating into the result
+
+        /// the input vectors are stored with the vector index last, (kdim^NDIM, nrank),
+        /// so that each mTxmq contracts one physical dimension of all vectors and
+        /// rotates the new index to the end; after NDIM steps the result is in the
+        /// usual order (nrank, kdim^NDIM) and can be added to result.
+        template <typename T, typename R>
+        void apply_transformation_batched(long dimk, long nrank,
+                                  const Q* const U[NDIM],
+                                  const Tensor<T>& f,
+                                  Tensor<R>& work1,
+                                  Tensor<R>& work2,
+                                  const Q mufac,
+                                  Tensor<R>& result) const {
+
+            long size = nrank;
+            for (std::size_t i=0; i<NDIM; ++i) size *= dimk;
+            const long dimi = size/dimk;
+
+            R* restrict w1=work1.ptr();
+            R* restrict w2=work2.ptr();
+
+            mTxmq(dimi, dimk, dimk, w1, f.ptr(), U[0]);
+            for (std::size_t d=1; d<NDIM; ++d) {
+                mTxmq(dimi, dimk, dimk, w2, w1, U[d]);
+                std::swap(w1,w2);
+            }
+
+            R* restrict p=result.ptr();
+            for (long i=0; i<size; ++i) p[i]+=mufac*w1[i];
+        }
+
+        /// Apply one of the separated terms to all vectors of a low rank tensor, accumulating into the result
+
+        /// same as muopxv_fast, but all vectors are processed in the same matrix multiplications,
+        /// and always with the full operator matrices
+        /// @param[in]  n       the level of the source node
+        /// @param[in]  nrank   the number of vectors
+        /// @param[in]  f       the vectors of size (2k)^NDIM, transposed: (2k,...,2k,nrank)
+        /// @param[in]  f0      the vectors of size k^NDIM, transposed: (k,...,k,nrank)
+        /// @param[in,out]  result  the vectors (nrank,2k,...,2k), the operator is added
+        /// @param[in,out]  result0 the vectors (nrank,k,...,k), the T-part of the operator is subtracted
+        template <typename T>
+        void muopxv_batched(Level n,
+                         const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                         const long nrank,
+                         const Tensor<T>& f, const Tensor<T>& f0,
+                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& result,
+                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& result0,
+                         const Q mufac,
+                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work1,
+                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work2) const {
+
+            const Q* U[NDIM];
+
+            double Rnorm = 1.0;
+            for (std::size_t d=0; d<NDIM; ++d) Rnorm *= ops_1d[d]->Rnorm;
+            if (Rnorm > 1.e-20) {
+                const long twok = modified() ? k : 2*k;
+                for (std::size_t d=0; d<NDIM; ++d) U[d]=ops_1d[d]->R.ptr();
+                apply_transformation_batched(twok, nrank, U, f, work1, work2, mufac, result);
+            }
+
+            double Tnorm = 1.0;
+            for (std::size_t d=0; d<NDIM; ++d) Tnorm *= ops_1d[d]->Tnorm;
+            if ((n > 0) and (Tnorm>0.0)) {
+                for (std::size_t d=0; d<NDIM; ++d) U[d]=ops_1d[d]->T.ptr();
+                apply_transformation_batched(k, nrank, U, f0, work1, work2, -mufac, result0);
+            }
+        }
+
+
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast2(Level n,
@@ -1214,60 +1286,51 @@ namespace madness {
             // can't use predefined slices and vectors -- they have the wrong dimension
             const std::vector<Slice> s00(coeff.ndim(),Slice(0,k-1));
 
-            // some workspace
-            Tensor<resultT> work1(v2k,false), work2(v2k,false);
-            Tensor<Q> work5(2*k,2*k);
-
             // sliced input and final result
             const GenTensor<T> f0 = copy(coeff(s00));
             GenTensor<resultT> final=copy(coeff);
             GenTensor<resultT> final0=copy(f0);
 
-            tol = tol/rank*0.01; // Error is per separated term
             tol2= tol2/rank;
 
-            for (int r=0; r<coeff.rank(); ++r) {
-
-                // get the appropriate singular vector (left or right depends on particle)
-                // and apply the full tensor muopxv_fast on it, term by term
-                s[0]=Slice(r,r);
-                const Tensor<T> chunk=coeff.config().ref_vector(particle()-1)(s).reshape(2*k,2*k,2*k);
-                const Tensor<T> chunk0=f0.config().ref_vector(particle()-1)(s).reshape(k,k,k);
-//                const double weight=coeff.config().weights(r);
-
-                // accumulate all terms of the operator for a specific term of the function
-                Tensor<resultT> result(v2k), result0(vk);
-
-                ApplyTerms at;
-                at.r_term=true;
-                at.t_term=source.level()>0;
+            const long nrank=coeff.rank();
+            if (nrank>0) {
+                s[0]=Slice(0,nrank-1);
+                const int ivec=particle()-1;
+
+                // the singular vectors of the particle this operator acts on, with the
+                // rank index rotated to the end, so all ranks are transformed together
+                const Tensor<T> chunk=coeff.config().ref_vector(ivec)(s);
+                const Tensor<T> chunk0=f0.config().ref_vector(ivec)(s);
+                const Tensor<T> f=transpose(chunk.reshape(nrank,chunk.size()/nrank));
+                const Tensor<T> ff0=transpose(chunk0.reshape(nrank,chunk0.size()/nrank));
+
+                // accumulate all terms of the operator for all terms of the function
+                std::vector<long> vr(NDIM+1,2*k), vr0(NDIM+1,k);
+                vr[0]=nrank;
+                vr0[0]=nrank;
+                Tensor<resultT> result(vr), result0(vr0);
+                Tensor<resultT> work1(vr,false), work2(vr,false);
 
                 // this loop will return on result and result0 the terms [(P+Q) G (P+Q)]_1,
                 // and [P Q P]_1, respectively
                 for (int mu=0; mu<rank; ++mu) {
                     const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
-
-//                    if (muop.norm > tol2*std::abs(weight)) {
-
-                        Q fac = ops[mu].getfac();
-                        muopxv_fast(at, muop.ops, chunk, chunk0, result, result0,
-                                tol/std::abs(fac), fac, work1, work2, work5);
-
-//                    }
+                    const Q fac = ops[mu].getfac();
+                    muopxv_batched(source.level(), muop.ops, nrank, f, ff0, result, result0,
+                            fac, work1, work2);
                 }
 
-
                 // reinsert the transformed terms into result, leaving the other particle unchanged
                 MADNESS_ASSERT(final.config().has_structure());
-                final.config().ref_vector(particle()-1)(s)=result;
+                final.config().ref_vector(ivec)(s)=result;
 
                 if (source.level()>0) {
-                    final0.config().ref_vector(particle()-1)(s)=result0;
+                    final0.config().ref_vector(ivec)(s)=result0;
                 } else {
                     final0.config().ref_vector(0)(s)=0.0;
                     final0.config().ref_vector(1)(s)=0.0;
                 }
-
             }
 
             final(s00)+=final0;
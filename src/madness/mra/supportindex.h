@@ -0,0 +1,229 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+#ifndef MADNESS_MRA_SUPPORTINDEX_H__INCLUDED
+#define MADNESS_MRA_SUPPORTINDEX_H__INCLUDED
+
+/// \file supportindex.h
+/// \brief Provides SupportIndex for screening pairs of functions
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include <madness/world/world.h>
+#include <madness/tensor/tensor.h>
+#include <madness/mra/key.h>
+
+namespace madness {
+
+    /// Occupancy of the boxes of a coarse level by a vector of functions
+
+    /// For every function the boxes of level n in which its norm exceeds a
+    /// floor are kept as a list of box numbers and norms, sorted by number.
+    /// Pairs of functions, or a function and a key, can then be screened
+    /// without touching the trees.  The index is replicated on all processes;
+    /// it is made by vmra's support_indices() from the norm tree.
+    ///
+    /// The pairs screened by the vector operations are counted on each
+    /// process, see print_screening().
+    template <std::size_t NDIM>
+    class SupportIndex {
+    public:
+        typedef std::pair<long,double> boxnormT; ///< Number and norm of an occupied box
+
+    private:
+        Level n;
+        std::vector< std::vector<boxnormT> > support;
+
+        static std::pair<long,long>& counts() {
+            static std::pair<long,long> c(0,0); // pairs considered, pairs skipped
+            return c;
+        }
+
+    public:
+        /// The level of the boxes used by the vector operations
+        static Level default_level() {
+            return std::max(1,12/int(NDIM));
+        }
+
+        /// The number of boxes of level n
+        static long nbox(Level n) {
+            return 1l<<(NDIM*n);
+        }
+
+        /// The number of the box of level n that contains key, which must be at level n or below
+        static long box(const Key<NDIM>& key, Level n) {
+            const Vector<Translation,NDIM>& l = key.translation();
+            const Level shift = key.level() - n;
+            long b = 0;
+            for (std::size_t d=0; d<NDIM; ++d) b = (b<<n) + (l[d]>>shift);
+            return b;
+        }
+
+        /// Calls op(b) for all boxes of level n covered by key, which must be at level n or above
+        template <typename opT>
+        static void for_each_box(const Key<NDIM>& key, Level n, opT op) {
+            const Level shift = n - key.level();
+            const Translation s = Translation(1)<<shift;
+            const Vector<Translation,NDIM>& l = key.translation();
+            Vector<Translation,NDIM> o(Translation(0));
+            while (true) {
+                long b = 0;
+                for (std::size_t d=0; d<NDIM; ++d) b = (b<<n) + ((l[d]<<shift) + o[d]);
+                op(b);
+                std::size_t d = NDIM;
+                while (d > 0 and ++o[d-1] == s) o[--d] = 0;
+                if (d == 0) break;
+            }
+        }
+
+        SupportIndex() : n(0) {}
+
+        /// Makes the index from the box norms of the functions
+
+        /// @param[in]  n           the level of the boxes
+        /// @param[in]  boxnorms    tensor(nfunc, nbox(n)) of the norms of the functions in the boxes
+        /// @param[in]  floor       boxes with norms below floor are not occupied
+        SupportIndex(Level n, const Tensor<double>& boxnorms, double floor)
+            : n(n), support(boxnorms.dim(0))
+        {
+            MADNESS_ASSERT(boxnorms.ndim() == 2 and boxnorms.dim(1) == nbox(n));
+            for (long i=0; i<boxnorms.dim(0); ++i) {
+                const double* norms = boxnorms.ptr() + i*boxnorms.dim(1);
+                for (long b=0; b<boxnorms.dim(1); ++b)
+                    if (norms[b] > floor) support[i].push_back(boxnormT(b,norms[b]));
+            }
+        }
+
+        /// The level of the boxes
+        Level level() const {
+            return n;
+        }
+
+        /// The number of functions
+        long size() const {
+            return support.size();
+        }
+
+        /// The occupied boxes of function i, sorted by number
+        const std::vector<boxnormT>& boxes(long i) const {
+            return support[i];
+        }
+
+        /// True if function i may be significant in the box of key
+
+        /// Keys above level n are occupied if any box is
+        bool occupies(long i, const Key<NDIM>& key) const {
+            const std::vector<boxnormT>& s = support[i];
+            if (key.level() < n) return not s.empty();
+            const boxnormT b(box(key,n),0.0);
+            typename std::vector<boxnormT>::const_iterator it = std::lower_bound(s.begin(), s.end(), b);
+            return (it != s.end() and it->first == b.first);
+        }
+
+        /// The largest product of the box norms of function i and function j of other
+        double overlap(long i, const SupportIndex<NDIM>& other, long j) const {
+            MADNESS_ASSERT(n == other.n);
+            const std::vector<boxnormT>& s = support[i];
+            const std::vector<boxnormT>& t = other.support[j];
+            double r = 0.0;
+            for (std::size_t p=0, q=0; p<s.size() and q<t.size(); ) {
+                if (s[p].first < t[q].first) ++p;
+                else if (t[q].first < s[p].first) ++q;
+                else r = std::max(r, s[p++].second*t[q++].second);
+            }
+            return r;
+        }
+
+        /// The pairs (i,j) of overlap at least screen, ordered by i and j
+
+        /// Only the boxes shared by the functions are visited, so for
+        /// localized functions the cost grows linearly with their number.
+        /// @param[in]  other   index of the second functions
+        /// @param[in]  screen  pairs of smaller overlap are skipped
+        /// @param[in]  lower   only pairs j<=i
+        std::vector< std::pair<int,int> >
+        pairs(const SupportIndex<NDIM>& other, double screen, bool lower=false) const {
+            MADNESS_ASSERT(n == other.n);
+            // the functions of other occupying each box
+            std::vector< std::vector< std::pair<int,double> > > inbox(nbox(n));
+            for (long j=0; j<other.size(); ++j) {
+                const std::vector<boxnormT>& t = other.support[j];
+                for (std::size_t q=0; q<t.size(); ++q)
+                    inbox[t[q].first].push_back(std::make_pair(int(j),t[q].second));
+            }
+
+            std::vector< std::pair<int,int> > r;
+            std::vector<char> mark(other.size(),0);
+            std::vector<int> js;
+            for (long i=0; i<size(); ++i) {
+                const std::vector<boxnormT>& s = support[i];
+                for (std::size_t p=0; p<s.size(); ++p) {
+                    const std::vector< std::pair<int,double> >& f = inbox[s[p].first];
+                    for (std::size_t q=0; q<f.size(); ++q) {
+                        const int j = f[q].first;
+                        if (mark[j] or (lower and j > i)) continue;
+                        if (s[p].second*f[q].second >= screen) {
+                            mark[j] = 1;
+                            js.push_back(j);
+                        }
+                    }
+                }
+                std::sort(js.begin(), js.end());
+                for (std::size_t q=0; q<js.size(); ++q) {
+                    r.push_back(std::make_pair(int(i),js[q]));
+                    mark[js[q]] = 0;
+                }
+                js.clear();
+            }
+            return r;
+        }
+
+        /// Adds to the counts of the pairs considered and skipped by the screening on this process
+        static void count_screening(long npair, long nskip) {
+            counts().first += npair;
+            counts().second += nskip;
+        }
+
+        /// Prints and resets the counts of the screened pairs of this process
+        static void print_screening(World& world, const char* what) {
+            std::pair<long,long>& c = counts();
+            if (world.rank() == 0 and c.first > 0)
+                printf("  %s: %ld of %ld pairs skipped by support screening (%.1f%%)\n",
+                       what, c.second, c.first, 100.0*double(c.second)/double(c.first));
+            c = std::make_pair(0l,0l);
+        }
+    };
+}
+
+#endif // MADNESS_MRA_SUPPORTINDEX_H__INCLUDED
@@ -140,6 +140,12 @@ static double gauss_6d(const coord_6d& r) {
     return gauss_3d(r1)*gauss_3d(r2);
 }
 
+static double gaussian_6d(const coord_6d& r) {
+    double rsq=0.0;
+    for (int i=0; i<6; ++i) rsq+=r[i]*r[i];
+    return exp(-rsq);
+}
+
 static double slater_6d(const coord_6d& r) {
     const double rr=r12(r);
     const double _gamma=1.0;
@@ -219,6 +225,46 @@ int test_hartree_product(World& world, const long& k, const double thresh) {
 	return nerror;
 }
 
+/// test projection of a separable function through its 1D factors
+int test_separable(World& world, const long& k, const double thresh) {
+
+    print("entering separable");
+    int nerror=0;
+    bool good;
+
+    Tensor<double> c(1), e(1);
+    c=1.0;
+    e=1.0;
+    std::shared_ptr<FunctionFunctorInterface<double,6> >
+        functor(new GaussianSumFunctor<double,6>(c,e));
+
+    const FunctionCommonData<double,6>& cdata=FunctionCommonData<double,6>::get(k);
+    const double cell_volume=FunctionDefaults<6>::get_cell_volume();
+
+    // compare the boxwise coefficients against the quadrature of point values
+    for (Level n=1; n<4; ++n) {
+        Vector<Translation,6> l;
+        for (int i=0; i<6; ++i) l[i]=(Translation(1)<<n)/2 - (i%2);
+        Key<6> key(n,l);
+
+        double t0=wall_time();
+        Tensor<double> sep=functor->coeff(key).full_tensor_copy();
+        double t1=wall_time();
+        Tensor<double> fval=fcube(key,gaussian_6d,cdata.quad_x);
+        Tensor<double> ref=transform(fval,cdata.quad_phiw).scale(sqrt(cell_volume*pow(0.5,6*n)));
+        double t2=wall_time();
+
+        double err=(sep-ref).normf()/ref.normf();
+        good=is_small(err,thresh);
+        print(ok(good), "separable coefficients at level",n,err,
+                "time separable/pointwise",t1-t0,t2-t1);
+        if (not good) nerror++;
+    }
+
+    print("all done\n");
+    return nerror;
+}
+
 /// test f(1,2)*g(1)
 int test_multiply(World& world, const long& k, const double thresh) {
 
@@ -708,6 +754,7 @@ int main(int argc, char**argv) {
 
 //    test(world,k,thresh);
 //    error+=test_hartree_product(world,k,thresh);
+    error+=test_separable(world,k,thresh);
     error+=test_convolution(world,k,thresh);
 //    error+=test_multiply(world,k,thresh);
     error+=test_add(world,k,thresh);
@@ -0,0 +1,217 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+
+  $Id$
+*/
+
+/// \file testpmap.cc
+/// \brief compares the locality of process maps for apply and derivatives
+
+/// For each process map the fraction of face neighbors of the leaf nodes
+/// that live on another process is reported for a given number of
+/// processes (first argument, default is the number of processes, or 16
+/// if running on a single process).  Running in parallel additionally
+/// reports the number of active messages sent during a Coulomb apply and a
+/// derivative.  Finally the cost per process predicted by a cost model is
+/// compared to the cpu time measured during apply, multiplication and
+/// compress.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <madness/constants.h>
+
+using namespace madness;
+
+typedef Key<3> keyT;
+typedef std::shared_ptr< WorldDCPmapInterface<keyT> > pmapT;
+
+double ttt, sss;
+#define START_TIMER world.gop.fence(); ttt=wall_time(); sss=cpu_time()
+#define END_TIMER(msg) ttt=wall_time()-ttt; sss=cpu_time()-sss; if (world.rank()==0) printf("timer: %20.20s %8.2fs %8.2fs\n", msg, sss, ttt)
+
+/// A few atom-like Gaussians, so that the tree is far from uniform
+static double molecule(const coord_3d& r) {
+    static const double centers[4][3] = {{0.0,0.0,0.0}, {1.4,0.0,0.0}, {-0.5,1.2,0.3}, {0.3,-0.8,-1.1}};
+    double sum=0.0;
+    for (int i=0; i<4; ++i) {
+        const double x=r[0]-centers[i][0], y=r[1]-centers[i][1], z=r[2]-centers[i][2];
+        sum += exp(-20.0*(x*x+y*y+z*z));
+    }
+    return sum;
+}
+
+struct lbcost {
+    double operator()(const keyT& key, const FunctionNode<double,3>& node) const {
+        return 1.0;
+    }
+};
+
+struct lbzero {
+    double operator()(const keyT& key, const FunctionNode<double,3>& node) const {
+        return 0.0;
+    }
+};
+
+/// Fraction of the face neighbors of all leaf nodes owned by another process
+double remote_fraction(World& world, const real_function_3d& f, const pmapT& pmap) {
+    double count[2]={0.0,0.0};
+    typedef FunctionImpl<double,3>::dcT dcT;
+    const dcT& coeffs=f.get_impl()->get_coeffs();
+    for (dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+        const keyT& key=it->first;
+        if (it->second.has_children()) continue;
+        const Translation nbox=Translation(1)<<key.level();
+        const ProcessID me=pmap->owner(key);
+        for (std::size_t d=0; d<3; ++d) {
+            for (int s=-1; s<=1; s+=2) {
+                Vector<Translation,3> l=key.translation();
+                l[d]+=s;
+                if (l[d]<0 or l[d]>=nbox) continue;
+                count[0]+=1.0;
+                if (pmap->owner(keyT(key.level(),l))!=me) count[1]+=1.0;
+            }
+        }
+    }
+    world.gop.sum(count,2);
+    return (count[0]>0.0) ? count[1]/count[0] : 0.0;
+}
+
+/// Number of active messages sent by all processes since the last call
+double messages_sent(World& world) {
+    static uint64_t last=0;
+    world.gop.fence();
+    const uint64_t now=RMI::get_stats().nmsg_sent;
+    double n=now-last;
+    world.gop.sum(n);
+    last=RMI::get_stats().nmsg_sent;
+    return n;
+}
+
+void test_pmap(World& world, const std::string& name, const pmapT& pmap, const pmapT& analysis_pmap) {
+    FunctionDefaults<3>::set_pmap(pmap);
+    real_function_3d f=real_factory_3d(world).f(molecule);
+    f.truncate();
+
+    const double fraction=remote_fraction(world,f,analysis_pmap);
+    if (world.rank()==0) print(name,": remote face neighbors",fraction);
+
+    real_convolution_3d op=CoulombOperator(world,1.e-3,FunctionDefaults<3>::get_thresh());
+    real_derivative_3d D(world,0);
+
+    messages_sent(world);
+    START_TIMER;
+    real_function_3d g=apply(op,f);
+    END_TIMER("Coulomb apply");
+    const double napply=messages_sent(world);
+
+    START_TIMER;
+    real_function_3d df=D(f);
+    END_TIMER("derivative");
+    const double nderiv=messages_sent(world);
+
+    if (world.rank()==0) print(name,": messages sent by apply",napply,"derivative",nderiv,"\n");
+}
+
+int main(int argc, char**argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world,argc,argv);
+
+    const double L=20.0;
+    FunctionDefaults<3>::set_cubic_cell(-L,L);
+    FunctionDefaults<3>::set_k(8);
+    FunctionDefaults<3>::set_thresh(1.e-6);
+    FunctionDefaults<3>::set_truncate_mode(1);
+
+    int nproc=world.size();
+    if (argc>1) nproc=atoi(argv[1]);
+    else if (nproc==1) nproc=16;
+    const bool analysis_only=(nproc!=world.size());
+    if (world.rank()==0) print("analyzing process maps for",nproc,"processes\n");
+
+    pmapT pmap0=FunctionDefaults<3>::get_pmap();
+    pmapT levelpmap(new LevelPmap<keyT>(world));
+    pmapT levelpmap_n(new LevelPmap<keyT>(nproc));
+    test_pmap(world,"LevelPmap",levelpmap,levelpmap_n);
+
+    pmapT sfcpmap(new SFCPmap<3>(world));
+    pmapT sfcpmap_n(new SFCPmap<3>(nproc,SFCPmap<3>::default_level(nproc)));
+    test_pmap(world,"SFCPmap",sfcpmap,sfcpmap_n);
+
+    // cost-weighted segments from the tree of a sample function
+    real_function_3d f=real_factory_3d(world).f(molecule);
+    LoadBalanceDeux<3> lb(world);
+    lb.add_tree(f,lbcost(),true);
+    const Level level=SFCPmap<3>::default_level(nproc);
+    const std::vector<double> cost=lb.sfc_box_costs(level);
+    const double uniform=lb.imbalance(lb.sfc_cost_per_proc(cost,SFCPmap<3>::uniform_cuts(nproc,level)));
+    if (world.rank()==0) print("SFCPmap : imbalance (max/avg cost)",uniform);
+    pmapT lbpmap_n=lb.load_balance_sfc(0,nproc,true);
+    pmapT lbpmap=analysis_only ? sfcpmap : lb.rebalance_sfc(sfcpmap,0.1,true);
+    test_pmap(world,"SFCPmap (cost)",lbpmap,lbpmap_n);
+
+    // measured cost of apply, multiplication and compress versus the cost model
+    FunctionDefaults<3>::set_pmap(lbpmap);
+    real_function_3d g=real_factory_3d(world).f(molecule);
+    real_convolution_3d op=CoulombOperator(world,1.e-3,FunctionDefaults<3>::get_thresh());
+    MeasuredCost<3>::enable();
+    START_TIMER;
+    real_function_3d h=apply(op,g);
+    h.reconstruct();
+    h=h*g;
+    h.compress();
+    END_TIMER("measured work");
+    MeasuredCost<3>::enable(false);
+
+    LoadBalanceDeux<3> lbm(world);
+    lbm.add_tree(g,lbcost());
+    lbm.add_tree(h,lbcost(),true);
+    if (world.rank()==0) print("\npredicted (one per node) versus measured cost per process");
+    lbm.print_cost_per_proc(lbpmap);
+
+    // balance on the measured cost alone
+    LoadBalanceDeux<3> lbt(world);
+    lbt.add_tree(g,lbzero());
+    lbt.add_tree(h,lbzero(),true);
+    lbt.add_measured_cost(1.0,true);
+    if (analysis_only) {
+        const double predicted=lbm.imbalance(lbm.cost_per_proc(lbpmap_n,nproc));
+        const double measured=lbt.imbalance(lbt.cost_per_proc(lbpmap_n,nproc));
+        if (world.rank()==0) print("SFCPmap (cost) : imbalance (max/avg) predicted",predicted,"measured",measured);
+    }
+    lbt.load_balance_sfc(0,nproc,true);
+    MeasuredCost<3>::clear();
+
+    FunctionDefaults<3>::set_pmap(pmap0);
+    world.gop.fence();
+    finalize();
+    return 0;
+}
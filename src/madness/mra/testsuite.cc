@@ -39,6 +39,9 @@
 #include <madness/mra/mra.h>
 #include <unistd.h>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <madness/constants.h>
 #include <madness/mra/qmprop.h>
 
@@ -90,6 +93,52 @@ public:
     };
 };
 
+/// The same Gaussian through the vectorized or the tensor-product grid interface
+template <typename T, std::size_t NDIM>
+class BatchedGaussian : public Gaussian<T,NDIM> {
+    const bool grid;
+public:
+    typedef Vector<double,NDIM> coordT;
+
+    BatchedGaussian(const coordT& center, double exponent, T coefficient, bool grid)
+            : Gaussian<T,NDIM>(center, exponent, coefficient), grid(grid) {};
+
+    T operator()(const coordT& x) const {return Gaussian<T,NDIM>::operator()(x);}
+
+    bool supports_vectorized() const {return !grid;}
+
+    bool supports_grid() const {return grid;}
+
+    void operator()(const Vector<double*,NDIM>& xvals, T* fvals, int npts) const {
+        for (int i=0; i<npts; ++i) {
+            double sum = 0.0;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                double xx = this->center[d]-xvals[d][i];
+                sum += xx*xx;
+            }
+            fvals[i] = this->coefficient*exp(-this->exponent*sum);
+        }
+    }
+
+    void operator()(const Vector<const double*,NDIM>& x, int npt, T* fvals) const {
+        long npts = 1;
+        for (std::size_t d=0; d<NDIM; ++d) npts *= npt;
+        std::vector<double> g(NDIM*npt);
+        for (std::size_t d=0; d<NDIM; ++d) {
+            for (int i=0; i<npt; ++i) {
+                double xx = this->center[d]-x[d][i];
+                g[d*npt+i] = exp(-this->exponent*xx*xx);
+            }
+        }
+        for (long idx=0; idx<npts; ++idx) {
+            T v = this->coefficient;
+            long rest = idx;
+            for (long d=NDIM-1; d>=0; --d, rest/=npt) v *= g[d*npt + rest%npt];
+            fvals[idx] = v;
+        }
+    }
+};
+
 template <typename T, std::size_t NDIM>
 class DerivativeGaussian : public FunctionFunctorInterface<T,NDIM> {
 public:
@@ -240,6 +289,34 @@ int test_basic(World& world) {
     CHECK(new_norm-norm, 1e-9, "new_norm");
     CHECK(new_err, 3e-5, "new_err");
 
+    // the vectorized and tensor-product grid projections agree with the pointwise one
+    {
+        functorT vfunctor(new BatchedGaussian<T,NDIM>(origin, expnt, coeff, false));
+        functorT gfunctor(new BatchedGaussian<T,NDIM>(origin, expnt, coeff, true));
+
+        double t0 = wall_time();
+        Function<T,NDIM> fs = FunctionFactory<T,NDIM>(world).functor(functor);
+        double t1 = wall_time();
+        Function<T,NDIM> fv = FunctionFactory<T,NDIM>(world).functor(vfunctor);
+        double t2 = wall_time();
+        Function<T,NDIM> fg = FunctionFactory<T,NDIM>(world).functor(gfunctor);
+        double t3 = wall_time();
+        CHECK((fv-fs).norm2(), 1e-12, "vectorized projection");
+        CHECK((fg-fs).norm2(), 1e-12, "grid projection");
+        if (world.rank() == 0) print("projection pointwise",t1-t0,"vectorized",t2-t1,"grid",t3-t2);
+
+        Tensor<T> gcoeff(1);
+        Tensor<double> gexpnt(1);
+        gcoeff(0L) = complexify(T(coeff));
+        gexpnt(0L) = expnt;
+        double t4 = wall_time();
+        Function<T,NDIM> fsum = FunctionFactory<T,NDIM>(world)
+                .functor(functorT(new GaussianSumFunctor<T,NDIM>(gcoeff, gexpnt, origin)));
+        double t5 = wall_time();
+        CHECK((fsum-fs).norm2(), 1e-12, "separable projection");
+        if (world.rank() == 0) print("projection separable",t5-t4);
+    }
+
     world.gop.fence();
     if (world.rank() == 0) print("projection, compression, reconstruction, truncation OK",ok,"\n\n");
     if (not ok) return 1;
@@ -531,11 +608,36 @@ int test_math(World& world) {
         vin[0].refine_to_common_level(vin);
         if (world.rank() == 0) print("\nTest multioperation");
         Function<T,NDIM> mop = multiop_values<T,test_multiop<T,NDIM>,NDIM> (test_multiop<T,NDIM>(), vin);
+        Function<T,NDIM> mopb = multiop_values_batched<T,test_multiop<T,NDIM>,NDIM> (test_multiop<T,NDIM>(), vin, 7);
         compress(world, vin);
         Function<T,NDIM> r(world);
         for (unsigned int i=0; i<vin.size(); i++) r += vin[i]*vin[i];
         double moperr = (r - mop).norm2();
         if (world.rank() == 0) print("\nTest DONE multi", moperr);
+        double batcherr = (mop - mopb).norm2();
+        CHECK(batcherr, 1e-14, "batched multioperation");
+    }
+
+    if (world.rank() == 0) print("\nTest fused multiply and truncate");
+    {
+        const double tol = 1e-6;
+        functorT f1(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),1000.0));
+        functorT f2(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),1000.0));
+        Function<T,NDIM> a = FunctionFactory<T,NDIM>(world).functor(f1);
+        Function<T,NDIM> b = FunctionFactory<T,NDIM>(world).functor(f2);
+        a.norm_tree();
+        b.norm_tree();
+        Function<T,NDIM> c = mul_sparse(a,b,tol);
+        const std::size_t peak = c.size();
+        c.truncate(tol);
+        c.reconstruct();
+        Function<T,NDIM> cf = mul_truncate(a,b,tol);
+        cf.verify_tree();
+        if (world.rank() == 0) print("  product size: mul_sparse",peak,"truncated",c.size(),"mul_truncate",cf.size());
+        if (cf.size() > peak) ok = false;
+        CHECK((cf-c).norm2(), 10.0*tol, "mul_truncate");
+        std::vector< Function<T,NDIM> > vc = mul_truncate(world, a, std::vector< Function<T,NDIM> >(1,b), tol);
+        CHECK((vc[0]-cf).norm2(), 1e-12, "vector mul_truncate");
     }
 
     if (world.rank() == 0) print("\nTest adding random functions out of place");
@@ -1162,6 +1264,22 @@ int test_plot(World& world) {
                 print("bad", i, coordT(x), fplot, fnum, (*functor)(coordT(x)));
             }
         }
+
+        // batched evaluation versus one point at a time
+        std::vector<coordT> xv(NDIM>3 ? 1000 : 20000);
+        for (std::size_t i=0; i<xv.size(); ++i) {
+            for (std::size_t d=0; d<NDIM; ++d) xv[i][d] = -L + 2.0*L*RandomValue<double>();
+        }
+        double t0=wall_time();
+        const std::vector<T> fv = f.eval_points(xv).get();
+        double t1=wall_time();
+        std::vector< Future<T> > fp(xv.size());
+        for (std::size_t i=0; i<xv.size(); ++i) fp[i] = f.eval(xv[i]);
+        double err=0.0;
+        for (std::size_t i=0; i<xv.size(); ++i) err=std::max(err,std::abs(fv[i]-fp[i].get()));
+        double t2=wall_time();
+        CHECK(err,1e-12,"eval_points");
+        print("eval_points", xv.size(), "points", t1-t0, "s, one at a time", t2-t1, "s");
     }
     world.gop.fence();
 
@@ -1172,6 +1290,43 @@ int test_plot(World& world) {
     plot_line("testline2", 101, coordT(-L), coordT(L), f, f*f);
     plot_line("testline3", 101, coordT(-L), coordT(L), f, f*f, 2.0*f);
 
+    // parallel binary VTK file versus eval_cube
+    if (NDIM<=3) {
+        const Vector<long,NDIM> nvtk(NDIM==3 ? 31 : 51);
+        const coordT lo(-0.8*L), hi(0.7*L);
+        Tensor<double> cell(NDIM,2);
+        for (std::size_t d=0; d<NDIM; ++d) {
+            cell(d,0)=lo[d];
+            cell(d,1)=hi[d];
+        }
+        const Tensor<T> cube = f.eval_cube(cell, std::vector<long>(nvtk.begin(),nvtk.end()));
+        plotvtk_image(f, "f", "testplot.vti", lo, hi, nvtk);
+        if (world.rank() == 0) {
+            const int ncomp = TensorTypeData<T>::iscomplex ? 2 : 1;
+            std::ifstream file("testplot.vti", std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            const std::size_t start = text.find("   _") + 4;
+            uint64_t nbyte;
+            memcpy(&nbyte, &text[start], sizeof(nbyte));
+            CHECK(double(nbyte) - double(cube.size()*ncomp*sizeof(float)), 0.5, "plotvtk_image size");
+            const float* data = reinterpret_cast<const float*>(&text[start+sizeof(nbyte)]);
+            double err = 0.0;
+            long pos = 0;
+            for (IndexIterator it(NDIM,&nvtk[0]); it; ++it) {
+                // the file runs the first dimension fastest
+                pos = 0;
+                for (int d=NDIM-1; d>=0; --d) pos = pos*nvtk[d] + it[d];
+                T value = cube(*it);
+                float v[2] = {0.0, 0.0};
+                detail::plotvtk_components(value, v);
+                err = std::max(err, double(std::abs(v[0]-data[ncomp*pos])));
+                if (ncomp==2) err = std::max(err, double(std::abs(v[1]-data[ncomp*pos+1])));
+            }
+            CHECK(err, 1e-6, "plotvtk_image values");
+        }
+        world.gop.fence();
+    }
+
     if (world.rank() == 0) print("evaluation of cube/slice for plotting OK", ok);
     if (ok) return 0;
     return 1;
@@ -1224,6 +1379,152 @@ int test_io(World& world) {
     return 1;
 }
 
+template <typename T, std::size_t NDIM>
+int test_compact(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest compact - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(1e-8);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    const coordT origin(0.0);
+    const double expnt = 10.0;
+    const double coeff = pow(2.0/PI,0.25*NDIM);
+    functorT functor(new Gaussian<T,NDIM>(origin, expnt, coeff));
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(functor);
+    f.compress();
+    Function<T,NDIM> g = copy(f);
+
+    const double norm = f.norm2();
+    const std::size_t size = f.get_impl()->real_size();
+    f.compact();
+    const std::size_t compact_size = f.get_impl()->real_size();
+    if (world.rank() == 0) print("real size before/after compact", size, compact_size);
+    if (compact_size >= size) ok = false;
+
+    CHECK(f.norm2()-norm, 1e-9, "norm of compact function");
+    CHECK(inner(f,g)-norm*norm, 1e-9, "inner with compact function");
+
+    f.expand();
+    CHECK(double(f.get_impl()->real_size())-double(size), 1.0, "size after expand");
+    CHECK((f-g).norm2(), 1e-9, "error after expand");
+
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
+/// scale the leaf coefficients in the right quarter of the cell, flagging those nodes as modified
+template <typename T, std::size_t NDIM>
+void scale_right_leaves(Function<T,NDIM>& f, const double factor) {
+    typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+    typename dcT::iterator end = f.get_impl()->get_coeffs().end();
+    for (typename dcT::iterator it=f.get_impl()->get_coeffs().begin(); it!=end; ++it) {
+        const Key<NDIM>& key = it->first;
+        if (it->second.is_leaf() and (4*key.translation()[0] >= 3*(Translation(1)<<key.level())))
+            it->second.coeff().scale(factor);
+    }
+    f.world().gop.fence();
+}
+
+template <typename T, std::size_t NDIM>
+int test_incremental(World& world) {
+    if (world.rank() == 0) {
+        print("\nTest incremental tree passes - type =", archive::get_type_name<T>(),", ndim =",NDIM,"\n");
+    }
+    bool ok=true;
+    typedef Vector<double,NDIM> coordT;
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > functorT;
+
+    FunctionDefaults<NDIM>::set_k(6);
+    FunctionDefaults<NDIM>::set_thresh(1e-6);
+    FunctionDefaults<NDIM>::set_truncate_mode(0);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(2);
+    FunctionDefaults<NDIM>::set_cubic_cell(-10,10);
+
+    const coordT origin(0.0);
+    coordT offset(0.0);
+    offset[0] = 5.0;
+    const double coeff = pow(2.0/PI,0.25*NDIM);
+    Function<T,NDIM> f = FunctionFactory<T,NDIM>(world).functor(functorT(new Gaussian<T,NDIM>(origin, 10.0, coeff)));
+    Function<T,NDIM> g = FunctionFactory<T,NDIM>(world).functor(functorT(new Gaussian<T,NDIM>(offset, 1.0, 1e-2*coeff)));
+
+    // truncate after a small update
+    f.truncate();
+    g.compress();
+    Function<T,NDIM> fref = copy(f);
+    f.gaxpy(1.0,g,1.0);
+    fref.gaxpy(1.0,g,1.0);
+    f.get_impl()->reset_nodes_touched();
+    fref.get_impl()->reset_nodes_touched();
+    f.truncate_incremental();
+    fref.truncate();
+    long nincr = f.get_impl()->get_nodes_touched();
+    long nfull = fref.get_impl()->get_nodes_touched();
+    if (world.rank() == 0) print("truncate: nodes touched incremental/full", nincr, nfull);
+    if (nincr >= nfull) ok = false;
+    CHECK(double(f.tree_size())-double(fref.tree_size()), 0.5, "truncate_incremental tree size");
+    CHECK((f-fref).norm2(), 1e-14, "truncate_incremental");
+
+    // norm_tree after modifying some leaves
+    f.reconstruct();
+    fref = copy(f);
+    f.norm_tree();
+    scale_right_leaves(f,2.0);
+    scale_right_leaves(fref,2.0);
+    f.get_impl()->reset_nodes_touched();
+    fref.get_impl()->reset_nodes_touched();
+    f.norm_tree_incremental();
+    fref.norm_tree();
+    nincr = f.get_impl()->get_nodes_touched();
+    nfull = fref.get_impl()->get_nodes_touched();
+    if (world.rank() == 0) print("norm_tree: nodes touched incremental/full", nincr, nfull);
+    if (nincr >= nfull) ok = false;
+    const Key<NDIM> key0(0);
+    double nt = 0.0, ntref = 0.0;
+    if (f.get_impl()->get_coeffs().is_local(key0)) {
+        nt = f.get_impl()->get_coeffs().find(key0).get()->second.get_norm_tree();
+        ntref = fref.get_impl()->get_coeffs().find(key0).get()->second.get_norm_tree();
+    }
+    world.gop.sum(nt);
+    world.gop.sum(ntref);
+    CHECK(nt-ntref, 1e-12, "norm_tree_incremental");
+
+    // sum coefficients of a redundant tree after modifying some leaves
+    fref = copy(f);
+    f.get_impl()->make_redundant(true);
+    scale_right_leaves(f,0.5);
+    scale_right_leaves(fref,0.5);
+    fref.get_impl()->make_redundant(true);
+    f.get_impl()->reset_nodes_touched();
+    f.get_impl()->make_redundant_incremental(true);
+    nincr = f.get_impl()->get_nodes_touched();
+    if (world.rank() == 0) print("make_redundant: nodes touched incremental/tree size", nincr, f.tree_size());
+    if (nincr >= long(f.tree_size())) ok = false;
+    double err = 0.0;
+    if (f.get_impl()->get_coeffs().is_local(key0)) {
+        err = (f.get_impl()->get_coeffs().find(key0).get()->second.coeff().full_tensor_copy()
+               - fref.get_impl()->get_coeffs().find(key0).get()->second.coeff().full_tensor_copy()).normf();
+    }
+    world.gop.sum(err);
+    CHECK(err, 1e-12, "make_redundant_incremental");
+    f.get_impl()->undo_redundant(true);
+    fref.get_impl()->undo_redundant(true);
+
+    world.gop.fence();
+    if (ok) return 0;
+    return 1;
+}
+
 template <typename T, std::size_t NDIM>
 int test_apply_push_1d(World& world) {
     typedef Vector<double,NDIM> coordT;
@@ -1333,6 +1634,8 @@ int main(int argc, char**argv) {
         nfail+=test_plot<double,1>(world);
         nfail+=test_apply_push_1d<double,1>(world);
         nfail+=test_io<double,1>(world);
+        nfail+=test_compact<double,1>(world);
+        nfail+=test_incremental<double,1>(world);
 
         // stupid location for this test
         GenericConvolution1D<double,GaussianGenericFunctor<double> > gen(10,GaussianGenericFunctor<double>(100.0,100.0),0);
@@ -1351,6 +1654,7 @@ int main(int argc, char**argv) {
         nfail+=test_op<double_complex,1>(world);
         nfail+=test_plot<double_complex,1>(world);
         nfail+=test_io<double_complex,1>(world);
+        nfail+=test_compact<double_complex,1>(world);
 
         //TaskInterface::debug = true;
         nfail+=test_basic<double,2>(world);
@@ -1369,6 +1673,8 @@ int main(int argc, char**argv) {
         nfail+=test_coulomb(world);
         nfail+=test_plot<double,3>(world);
         nfail+=test_io<double,3>(world);
+        nfail+=test_compact<double,3>(world);
+        nfail+=test_incremental<double,3>(world);
 
         test_plot<double,4>(world); // slow unless reduce npt in test_plot
 
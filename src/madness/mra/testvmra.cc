@@ -121,6 +121,128 @@ void test_inner(World& world) {
         print("error norm",(rold-rnew).normf(),"\n");
 }
 
+template <typename T, int NDIM>
+void test_transform(World& world) {
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > ffunctorT;
+
+    const double thresh=1.e-7;
+    Tensor<double> cell(NDIM,2);
+    for (std::size_t i=0; i<NDIM; ++i) {
+        cell(i,0) = -11.0-2*i;  // Deliberately asymmetric bounding box
+        cell(i,1) =  10.0+i;
+    }
+    FunctionDefaults<NDIM>::set_cell(cell);
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(thresh);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(3);
+    FunctionDefaults<NDIM>::set_truncate_mode(1);
+
+    const int n=40, m=30;
+
+    if (world.rank() == 0)
+        print("testing transform<",archive::get_type_name<T>(),">");
+
+    START_TIMER;
+    std::vector< Function<T,NDIM> > v(n);
+    for (int i=0; i<n; ++i) {
+        ffunctorT f(RandomGaussian<T,NDIM>(FunctionDefaults<NDIM>::get_cell(),0.5));
+        v[i] = FunctionFactory<T,NDIM>(world).functor(f);
+    }
+    Tensor<T> c(n,m);
+    c.fillrandom();
+    compress(world,v);
+    END_TIMER("project");
+
+    START_TIMER;
+    std::vector< Function<T,NDIM> > vnew = transform(world,v,c,0.0,true);
+    END_TIMER("new");
+    START_TIMER;
+    std::vector< Function<T,NDIM> > vold = transform(world,v,c,true);
+    END_TIMER("old");
+
+    START_TIMER;
+    std::vector<double> nn = norm2s(world,vnew);
+    END_TIMER("norm2s");
+
+    double err=norm2(world,sub(world,vnew,vold));
+    double norm=0.0;
+    for (int i=0; i<m; ++i) norm+=nn[i]*nn[i];
+    if (world.rank() == 0)
+        print("error norm",err,"norm",sqrt(norm),"\n");
+
+    // banded matrix, distributed by rows of its transpose
+    Tensor<T> cb(n,m);
+    for (int j=0; j<n; ++j)
+        for (int i=std::max(0,j-3); i<std::min(m,j+4); ++i) cb(j,i)=c(j,i);
+    DistributedMatrix<T> dc = column_distributed_matrix<T>(world, m, n);
+    dc.copy_from_replicated(transpose(cb));
+
+    START_TIMER;
+    std::vector< Function<T,NDIM> > vdist = transform(world,v,dc,0.0,true);
+    END_TIMER("distributed");
+    vold = transform(world,v,cb,true);
+    err=norm2(world,sub(world,vdist,vold));
+    if (world.rank() == 0)
+        print("distributed banded error norm",err,"\n");
+}
+
+template <typename T, int NDIM>
+void test_sparse(World& world) {
+    typedef std::shared_ptr< FunctionFunctorInterface<T,NDIM> > ffunctorT;
+    typedef Vector<double,NDIM> coordT;
+
+    const double thresh=1.e-6;
+    Tensor<double> cell(NDIM,2);
+    for (std::size_t i=0; i<NDIM; ++i) {
+        cell(i,0) = -11.0-2*i;  // Deliberately asymmetric bounding box
+        cell(i,1) =  10.0+i;
+    }
+    FunctionDefaults<NDIM>::set_cell(cell);
+    FunctionDefaults<NDIM>::set_k(8);
+    FunctionDefaults<NDIM>::set_thresh(thresh);
+    FunctionDefaults<NDIM>::set_refine(true);
+    FunctionDefaults<NDIM>::set_initial_level(3);
+    FunctionDefaults<NDIM>::set_truncate_mode(1);
+
+    const int n=20;
+
+    if (world.rank() == 0)
+        print("testing support screening<",archive::get_type_name<T>(),">");
+
+    // tight Gaussians along a line, so that most pairs do not overlap
+    START_TIMER;
+    std::vector< Function<T,NDIM> > v(n);
+    const double expnt = 10.0;
+    for (int i=0; i<n; ++i) {
+        coordT origin(0.0);
+        origin[0] = cell(0,0) + (i+0.5)*(cell(0,1)-cell(0,0))/n;
+        ffunctorT f(new Gaussian<T,NDIM>(origin,expnt,pow(2.0*expnt/PI,0.25*NDIM)));
+        v[i] = FunctionFactory<T,NDIM>(world).functor(f);
+    }
+    END_TIMER("project");
+
+    START_TIMER;
+    std::vector< Function<T,NDIM> > q = mul_sparse(world,v[n/2],v,thresh);
+    END_TIMER("mul_sparse");
+    START_TIMER;
+    std::vector< Function<T,NDIM> > qref = mul(world,v[n/2],v);
+    END_TIMER("mul");
+    double err=norm2(world,sub(world,q,qref));
+    if (world.rank() == 0)
+        print("mul_sparse error norm",err);
+
+    START_TIMER;
+    Tensor<T> rsparse = matrix_inner_sparse(world,v,v,thresh,true);
+    END_TIMER("sparse");
+    START_TIMER;
+    Tensor<T> rdense = matrix_inner(world,v,v,true);
+    END_TIMER("dense");
+    SupportIndex<NDIM>::print_screening(world,"mul_sparse and matrix_inner_sparse");
+    if (world.rank() == 0)
+        print("matrix_inner_sparse error norm",(rsparse-rdense).normf(),"\n");
+}
+
 int main(int argc, char**argv) {
     initialize(argc, argv);
 
@@ -128,8 +250,15 @@ int main(int argc, char**argv) {
         World world(SafeMPI::COMM_WORLD);
         startup(world,argc,argv);
 
+        test_transform<double,3>(world);
+#if !HAVE_GENTENSOR
+        test_transform<std::complex<double>,3>(world);
+#endif
+
         test_inner<double,double,3,false>(world);
         test_inner<double,double,3,true>(world);
+
+        test_sparse<double,3>(world);
 #if !HAVE_GENTENSOR
         test_inner<double,std::complex<double>,3,false>(world);
         test_inner<std::complex<double>,double,3,false>(world);
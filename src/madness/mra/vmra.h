@@ -100,6 +100,7 @@
 	*) sub
 	*) mul
 	   - mul_sparse
+	   - mul_truncate
 	*) square
 	*) gaxpy
 	*) apply
@@ -108,7 +109,9 @@
 
 	*) inner
 	*) matrix_inner
+	   - matrix_inner_sparse
 	*) norm_tree
+	*) box_norms, support_indices: screening of pairs of localized functions
 	*) normalize
 	*) norm2
 	    - norm2s
@@ -121,6 +124,7 @@
 
 #include <madness/mra/mra.h>
 #include <madness/mra/derivative.h>
+#include <madness/tensor/distributed_matrix.h>
 #include <cstdio>
 
 namespace madness {
@@ -301,6 +305,38 @@ namespace madness {
         return vresult;
     }
 
+
+    /// Transforms a vector of functions according to new[i] = sum[j] old[j]*c[i,j]
+
+    /// The rows of the distributed matrix hold the coefficients of the new
+    /// functions, as produced by the systolic algorithms.  Each process
+    /// contributes only the rows it owns, entries below \c tol are screened,
+    /// and the result is formed with one matrix product per key as in the
+    /// transform with a replicated matrix.
+    template <typename L, typename R, std::size_t NDIM>
+    std::vector< Function<TENSOR_RESULT_TYPE(L,R),NDIM> >
+    transform(World& world, const std::vector< Function<L,NDIM> >& v, const DistributedMatrix<R>& c,
+              double tol, bool fence=true) {
+        PROFILE_BLOCK(Vtransform_dist);
+        const int64_t n = c.rowdim();  // old dimension
+        const int64_t m = c.coldim();  // new dimension
+        MADNESS_ASSERT(int64_t(v.size()) == n);
+
+        // c(i,j) distributed by rows i; replicate transposed and screened
+        Tensor<R> ct(n,m);
+        int64_t ilo, ihi, jlo, jhi;
+        c.local_colrange(ilo, ihi);
+        c.local_rowrange(jlo, jhi);
+        if (c.local_size() > 0) {
+            Tensor<R> local = copy(c.data());
+            local.screen(tol);
+            ct(Slice(jlo,jhi),Slice(ilo,ihi)) = transpose(local);
+        }
+        world.gop.sum(ct.ptr(), ct.size());
+
+        return transform(world, v, ct, tol, fence);
+    }
+
     /// Scales inplace a vector of functions by distinct values
     template <typename T, typename Q, std::size_t NDIM>
     void scale(World& world,
@@ -328,8 +364,9 @@ namespace madness {
     std::vector<double> norm2s(World& world,
                               const std::vector< Function<T,NDIM> >& v) {
         PROFILE_BLOCK(Vnorm2);
-        std::vector<double> norms(v.size());
-        for (unsigned int i=0; i<v.size(); ++i) norms[i] = v[i].norm2sq_local();
+        std::vector<const FunctionImpl<T,NDIM>*> vimpl(v.size());
+        for (unsigned int i=0; i<v.size(); ++i) vimpl[i] = v[i].get_impl().get();
+        std::vector<double> norms = FunctionImpl<T,NDIM>::norm2sq_local(vimpl);
         world.gop.sum(&norms[0], norms.size());
         for (unsigned int i=0; i<v.size(); ++i) norms[i] = sqrt(norms[i]);
         world.gop.fence();
@@ -341,8 +378,9 @@ namespace madness {
     double norm2(World& world,
                               const std::vector< Function<T,NDIM> >& v) {
         PROFILE_BLOCK(Vnorm2);
-        std::vector<double> norms(v.size());
-        for (unsigned int i=0; i<v.size(); ++i) norms[i] = v[i].norm2sq_local();
+        std::vector<const FunctionImpl<T,NDIM>*> vimpl(v.size());
+        for (unsigned int i=0; i<v.size(); ++i) vimpl[i] = v[i].get_impl().get();
+        std::vector<double> norms = FunctionImpl<T,NDIM>::norm2sq_local(vimpl);
         world.gop.sum(&norms[0], norms.size());
         for (unsigned int i=1; i<v.size(); ++i) norms[0] += norms[i];
         world.gop.fence();
@@ -390,6 +428,73 @@ namespace madness {
 //        }
 //    }; // struct MatrixInnerTask
 
+    namespace detail {
+        /// Raises the norms of boxes to that of a node covering them
+        struct max_box_norm {
+            double* norms;
+            double norm;
+            max_box_norm(double* norms, double norm) : norms(norms), norm(norm) {}
+            void operator()(long b) {
+                norms[b] = std::max(norms[b],norm);
+            }
+        };
+    }
+
+    /// Computes the norms of a vector of functions in the boxes of level n
+
+    /// The functions must be reconstructed with a valid norm tree.  Leaves
+    /// above level n contribute their norm to all boxes they cover.
+    /// @return     tensor(v.size(), 2^(NDIM*n)) of the box norms, replicated
+    template <typename T, std::size_t NDIM>
+    Tensor<double> box_norms(World& world,
+                             const std::vector< Function<T,NDIM> >& v,
+                             Level n) {
+        PROFILE_BLOCK(Vbox_norms);
+        typedef typename FunctionImpl<T,NDIM>::dcT dcT;
+        Tensor<double> r(long(v.size()), SupportIndex<NDIM>::nbox(n));
+        for (unsigned int i=0; i<v.size(); ++i) {
+            const dcT& coeffs = v[i].get_impl()->get_coeffs();
+            for (typename dcT::const_iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+                const Level m = it->first.level();
+                if (m > n or (m < n and it->second.has_children())) continue;
+                detail::max_box_norm op(r.ptr() + i*r.dim(1), it->second.get_norm_tree());
+                SupportIndex<NDIM>::for_each_box(it->first, n, op);
+            }
+        }
+        world.gop.sum(r.ptr(), r.size());
+        return r;
+    }
+
+    /// Makes the support indices of two vectors of functions for screening their pairs
+
+    /// The functions are reconstructed and their norm trees made.  A box is
+    /// occupied by a function if its norm there times the largest box norm
+    /// of the other vector reaches screen, so that pairs sharing no box
+    /// are below screen in all boxes.
+    template <typename T, typename R, std::size_t NDIM>
+    void support_indices(World& world,
+                         const std::vector< Function<T,NDIM> >& f,
+                         const std::vector< Function<R,NDIM> >& g,
+                         double screen,
+                         SupportIndex<NDIM>& fsupport,
+                         SupportIndex<NDIM>& gsupport,
+                         Level n=SupportIndex<NDIM>::default_level()) {
+        const bool same = ((void*)(&f) == (void*)(&g));
+        reconstruct(world, f, false);
+        if (!same) reconstruct(world, g, false);
+        world.gop.fence();
+        norm_tree(world, f, false);
+        if (!same) norm_tree(world, g, false);
+        world.gop.fence();
+
+        const Tensor<double> fnorms = box_norms(world, f, n);
+        const Tensor<double> gnorms = same ? fnorms : box_norms(world, g, n);
+        const double fmax = fnorms.size() ? fnorms.max() : 0.0;
+        const double gmax = gnorms.size() ? gnorms.max() : 0.0;
+        fsupport = SupportIndex<NDIM>(n, fnorms, gmax > 0.0 ? screen/gmax : 0.0);
+        gsupport = SupportIndex<NDIM>(n, gnorms, fmax > 0.0 ? screen/fmax : 0.0);
+    }
+
     /// Computes the matrix inner product of two function vectors - q(i,j) = inner(f[i],g[j])
 
     /// For complex types symmetric is interpreted as Hermitian.
@@ -418,6 +523,48 @@ namespace madness {
         return r;
     }
 
+    /// Computes the matrix inner product of two function vectors, skipping pairs of disjoint support
+
+    /// Pairs whose product is below tol in all boxes of the screening level
+    /// are zero, and the coefficients of a function in boxes it does not
+    /// occupy are left out of the products, so that for localized functions
+    /// the cost grows about linearly with their number.  The functions are
+    /// reconstructed for the support indices and compressed for the products.
+    template <typename T, typename R, std::size_t NDIM>
+    Tensor< TENSOR_RESULT_TYPE(T,R) > matrix_inner_sparse(World& world,
+                                                          const std::vector< Function<T,NDIM> >& f,
+                                                          const std::vector< Function<R,NDIM> >& g,
+                                                          double tol,
+                                                          bool sym=false)
+    {
+        PROFILE_BLOCK(Vmatrix_inner_sparse);
+        SupportIndex<NDIM> fsupport, gsupport;
+        support_indices(world, f, g, tol, fsupport, gsupport);
+        const std::vector< std::pair<int,int> > pairs = fsupport.pairs(gsupport, tol);
+
+        compress(world, f);
+        if ((void*)(&f) != (void*)(&g)) compress(world, g);
+
+        std::vector<const FunctionImpl<T,NDIM>*> left(f.size());
+        std::vector<const FunctionImpl<R,NDIM>*> right(g.size());
+        for (unsigned int i=0; i<f.size(); i++) left[i] = f[i].get_impl().get();
+        for (unsigned int i=0; i<g.size(); i++) right[i]= g[i].get_impl().get();
+
+        Tensor< TENSOR_RESULT_TYPE(T,R) > r= FunctionImpl<T,NDIM>::inner_local(left, right, sym, &fsupport, &gsupport);
+
+        world.gop.fence();
+        world.gop.sum(r.ptr(),f.size()*g.size());
+
+        Tensor<int> keep(long(f.size()), long(g.size()));
+        for (std::size_t p=0; p<pairs.size(); ++p) keep(pairs[p].first,pairs[p].second) = 1;
+        for (long i=0; i<r.dim(0); ++i)
+            for (long j=0; j<r.dim(1); ++j)
+                if (!keep(i,j)) r(i,j) = 0.0;
+        SupportIndex<NDIM>::count_screening(r.size(), r.size()-pairs.size());
+
+        return r;
+    }
+
     /// Computes the matrix inner product of two function vectors - q(i,j) = inner(f[i],g[j])
 
     /// For complex types symmetric is interpreted as Hermitian.
@@ -526,6 +673,10 @@ namespace madness {
     }
 
     /// Multiplies a function against a vector of functions using sparsity of a and v[i] --- q[i] = a * v[i]
+
+    /// If tol is nonzero the support indices of a and v screen the products
+    /// before any tree is visited: v[i] sharing no significant box of the
+    /// screening level with a gives a zero function.
     template <typename T, typename R, std::size_t NDIM>
     std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> >
     mul_sparse(World& world,
@@ -534,14 +685,73 @@ namespace madness {
                double tol,
                bool fence=true) {
         PROFILE_BLOCK(Vmulsp);
+        typedef TENSOR_RESULT_TYPE(T,R) resultT;
+        if (tol == 0.0 or v.empty()) {
+            a.reconstruct(false);
+            reconstruct(world, v, false);
+            world.gop.fence();
+            for (unsigned int i=0; i<v.size(); ++i) {
+                v[i].norm_tree(false);
+            }
+            a.norm_tree();
+            return vmulXX(a, v, tol, fence);
+        }
+
+        // the screening threshold of the tree at the screening level
+        const Level n = SupportIndex<NDIM>::default_level();
+        const double screen = a.get_impl()->truncate_tol(tol, Key<NDIM>(n, Vector<Translation,NDIM>(Translation(0))));
+        SupportIndex<NDIM> asupport, vsupport;
+        support_indices(world, std::vector< Function<T,NDIM> >(1,a), v, screen, asupport, vsupport, n);
+        const std::vector< std::pair<int,int> > pairs = asupport.pairs(vsupport, screen);
+        SupportIndex<NDIM>::count_screening(v.size(), v.size()-pairs.size());
+
+        std::vector< Function<resultT,NDIM> > q = zero_functions<resultT,NDIM>(world, v.size(), false);
+        if (pairs.size()) {
+            std::vector< Function<R,NDIM> > vkeep(pairs.size());
+            for (std::size_t p=0; p<pairs.size(); ++p) vkeep[p] = v[pairs[p].second];
+            std::vector< Function<resultT,NDIM> > qkeep = vmulXX(a, vkeep, tol, false);
+            for (std::size_t p=0; p<pairs.size(); ++p) q[pairs[p].second] = qkeep[p];
+        }
+        if (fence) world.gop.fence();
+        return q;
+    }
+
+    /// Multiplies a function against a vector of functions with fused truncation --- q[i] = a * v[i]
+
+    /// Same as mul_sparse followed by truncate(tol), without creating the nodes
+    /// that the truncation would remove; see mul_truncate for two functions.
+    template <typename T, typename R, std::size_t NDIM>
+    std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> >
+    mul_truncate(World& world,
+                 const Function<T,NDIM>& a,
+                 const std::vector< Function<R,NDIM> >& v,
+                 double tol,
+                 bool fence=true) {
+        PROFILE_BLOCK(Vmultr);
+        if (tol <= 0.0) tol = a.thresh();
         a.reconstruct(false);
         reconstruct(world, v, false);
         world.gop.fence();
+        a.norm_tree(false);
         for (unsigned int i=0; i<v.size(); ++i) {
             v[i].norm_tree(false);
         }
-        a.norm_tree();
-        return vmulXX(a, v, tol, fence);
+        world.gop.fence();
+
+        std::vector< Function<TENSOR_RESULT_TYPE(T,R), NDIM> > q(v.size());
+        for (unsigned int i=0; i<v.size(); ++i) q[i].set_impl(a,false);
+        a.get_impl()->make_redundant(false);
+        for (unsigned int i=0; i<v.size(); ++i) v[i].get_impl()->make_redundant(false);
+        world.gop.fence();
+        for (unsigned int i=0; i<v.size(); ++i) {
+            q[i].get_impl()->mulXX_truncate(a.get_impl().get(), v[i].get_impl().get(), tol, false);
+        }
+        world.gop.fence();
+
+        a.get_impl()->undo_redundant(false);
+        for (unsigned int i=0; i<v.size(); ++i) v[i].get_impl()->undo_redundant(false);
+        if (fence) world.gop.fence();
+        return q;
     }
 
     /// Makes the norm tree for all functions in a vector
@@ -759,6 +969,8 @@ namespace madness {
             result[i] = apply_only(*op[i], f[i], false);
         }
 
+        world.gop.fence();
+        for (unsigned int i=0; i<f.size(); ++i) result[i].get_impl()->flush_apply_buffer(false);
         world.gop.fence();
 
         standard(world, ncf, false);  // restores promise of logical constness
@@ -787,6 +999,8 @@ namespace madness {
             result[i] = apply_only(op, f[i], false);
         }
 
+        world.gop.fence();
+        for (unsigned int i=0; i<f.size(); ++i) result[i].get_impl()->flush_apply_buffer(false);
         world.gop.fence();
 
         standard(world, ncf, false);  // restores promise of logical constness
@@ -897,6 +897,8 @@ namespace madness {
 	  world.gop.fence();
       }
 
+      world.gop.fence();
+      for (unsigned int j=0; j<ff; ++j) result[j].get_impl()->flush_apply_buffer(false);
       world.gop.fence();
 
       standard(world, ncf, false);  // restores promise of logical constness
@@ -932,6 +934,8 @@ namespace madness {
 	  world.gop.fence();
       }
       world.gop.fence();
+      for (unsigned int j=0; j<ff; ++j) result[j].get_impl()->flush_apply_buffer(false);
+      world.gop.fence();
 
       standard(world, ncf, blk, false);  // restores promise of logical constness
       world.gop.fence();
@@ -50,6 +50,8 @@
 #   define F77_DGEMM dgemm
 #   define F77_CGEMM cgemm
 #   define F77_ZGEMM zgemm
+#   define F77_SSYRK ssyrk
+#   define F77_DSYRK dsyrk
 #   define F77_SGEMV sgemv
 #   define F77_DGEMV dgemv
 #   define F77_CGEMV cgemv
@@ -75,6 +77,8 @@
 #   define F77_DGEMM dgemm_
 #   define F77_CGEMM cgemm_
 #   define F77_ZGEMM zgemm_
+#   define F77_SSYRK ssyrk_
+#   define F77_DSYRK dsyrk_
 #   define F77_SGEMV sgemv_
 #   define F77_DGEMV dgemv_
 #   define F77_CGEMV cgemv_
@@ -100,6 +104,8 @@
 #   define F77_DGEMM  dgemm__
 #   define F77_CGEMM  cgemm__
 #   define F77_ZGEMM  zgemm__
+#   define F77_SSYRK  ssyrk__
+#   define F77_DSYRK  dsyrk__
 #   define F77_SGEMV  sgemv__
 #   define F77_DGEMV  dgemv__
 #   define F77_CGEMV  cgemv__
@@ -125,6 +131,8 @@
 #   define F77_DGEMM  DGEMM
 #   define F77_CGEMM  CGEMM
 #   define F77_ZGEMM  ZGEMM
+#   define F77_SSYRK  SSYRK
+#   define F77_DSYRK  DSYRK
 #   define F77_SGEMV  SGEMV
 #   define F77_DGEMV  DGEMV
 #   define F77_CGEMV  CGEMV
@@ -150,6 +158,8 @@
 #   define F77_DGEMM  DGEMM_
 #   define F77_CGEMM  CGEMM_
 #   define F77_ZGEMM  ZGEMM_
+#   define F77_SSYRK  SSYRK_
+#   define F77_DSYRK  DSYRK_
 #   define F77_SGEMV  SGEMV_
 #   define F77_DGEMV  DGEMV_
 #   define F77_CGEMV  CGEMV_
@@ -192,6 +202,14 @@ extern "C" {
             const integer*, const complex_real8*, const integer*,
             const complex_real8*, complex_real8*, const integer*);
 
+    // BLAS _SYRK declarations
+    void F77_SSYRK(const char*, const char*, const integer*, const integer*,
+            const float*, const float*, const integer*, const float*, float*,
+            const integer*);
+    void F77_DSYRK(const char*, const char*, const integer*, const integer*,
+            const double*, const double*, const integer*, const double*, double*,
+            const integer*);
+
     // BLAS _GEMV declarations
     void F77_SGEMV(const char*, const integer*, const integer*, const float*,
             const float*, const integer*, const float*, const integer*,
@@ -308,6 +326,44 @@ namespace cblas {
     }
     ///@}
 
+    /// Symmetric rank-k update of a matrix
+
+    /// \f[
+    /// \mathbf{C} \leftarrow \alpha \mathbf{A}^{\mathrm{OpA}} (\mathbf{A}^{\mathrm{OpA}})^T + \beta \mathbf{C}
+    /// \f]
+    /// Only the triangle of \f$ \mathbf{C} \f$ selected by \c lower is referenced.
+    /// \param lower Update the lower (true) or upper (false) triangle of \f$ \mathbf{C} \f$
+    /// \param OpA Operation to be applied to matrix \f$ \mathbf{A} \f$
+    /// \param n Rows and columns in matrix \f$ \mathbf{C} \f$
+    /// \param k Inner dimension size for matrix \f$ \mathbf{A} \f$
+    /// \param alpha Scaling factor applied to \f$ \mathbf{A} \f$ \c * \f$ \mathbf{A}^T \f$
+    /// \param a Pointer to matrix \f$ \mathbf{A} \f$
+    /// \param lda The size of the leading-order dimension of matrix \f$ \mathbf{A} \f$
+    /// \param beta Scaling factor for matrix \f$ \mathbf{C} \f$
+    /// \param c Pointer to matrix \f$ \mathbf{C} \f$
+    /// \param ldc The size of the leading-order dimension of matrix \f$ \mathbf{C} \f$
+    ///@{
+    inline void syrk(const bool lower, const CBLAS_TRANSPOSE OpA,
+            const integer n, const integer k, const float alpha,
+            const float* a, const integer lda, const float beta, float* c,
+            const integer ldc)
+    {
+        MADNESS_ASSERT(OpA != ConjTrans);
+        static const char *op[] = { "n","t" };
+        F77_SSYRK(lower ? "l" : "u", op[OpA], &n, &k, &alpha, a, &lda, &beta, c, &ldc);
+    }
+
+    inline void syrk(const bool lower, const CBLAS_TRANSPOSE OpA,
+            const integer n, const integer k, const double alpha,
+            const double* a, const integer lda, const double beta, double* c,
+            const integer ldc)
+    {
+        MADNESS_ASSERT(OpA != ConjTrans);
+        static const char *op[] = { "n","t" };
+        F77_DSYRK(lower ? "l" : "u", op[OpA], &n, &k, &alpha, a, &lda, &beta, c, &ldc);
+    }
+    ///@}
+
     /// Multiplies a matrix by a vector
 
     /// \f[
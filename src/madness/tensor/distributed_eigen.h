@@ -0,0 +1,261 @@
+#ifndef MADNESS_DISTRIBUTED_EIGEN_H
+#define MADNESS_DISTRIBUTED_EIGEN_H
+
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+  $Id$
+*/
+
+/// \file tensor/distributed_eigen.h
+/// \brief Task-parallel Jacobi eigensolver for distributed matrices
+
+#include <madness/world/world.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/distributed_matrix.h>
+#include <madness/tensor/systolic.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace madness {
+
+    /// Jacobi solver for the generalized symmetric-definite eigenproblem A v = e B v
+
+    /// Each row i of the matrix holds the current vector v_i together with
+    /// a_i = A v_i and b_i = B v_i, i.e., row i is [v_i, a_i, b_i] and the
+    /// row dimension is three times the problem size.  For each pair of rows
+    /// the 2x2 projected problem is solved exactly (Loewdin orthonormalization
+    /// in the B metric followed by the smallest Jacobi rotation), and the
+    /// resulting transformation is applied to all three parts of both rows.
+    /// Since everything needed by a pair is in its two rows, all pairs
+    /// generated by the systolic loop are independent.
+    ///
+    /// Pairs that are already B-orthogonal and decoupled to within the
+    /// tolerance are skipped.  The iteration stops after a sweep without
+    /// rotations or after maxsweep sweeps.
+    template <typename T>
+    class SystolicJacobiEigensolver : public SystolicMatrixAlgorithm<T> {
+        const int64_t n;        ///< Problem size
+        const double tol;       ///< Skip rotations between pairs coupled less than this
+        const int maxsweep;     ///< Maximum number of sweeps
+        int& sweep;             ///< Number of sweeps done, owned by the caller
+        AtomicInt nrot;         ///< No. of rotations in the current sweep
+
+        static T dot(const int64_t n, const T* restrict a, const T* restrict b) {
+            T sum = 0;
+            for (int64_t k=0; k<n; ++k) sum += a[k]*b[k];
+            return sum;
+        }
+
+    public:
+        /// @param[in,out] A The (n,3n) column distributed matrix of rows [v_i, A v_i, B v_i]
+        /// @param[in] tol Convergence threshold for the off-diagonal couplings
+        /// @param[in] maxsweep Maximum number of sweeps
+        /// @param[out] nsweep On completion the number of sweeps performed (must outlive the task)
+        /// @param[in] tag The MPI tag used by the systolic loop
+        SystolicJacobiEigensolver(DistributedMatrix<T>& A, double tol, int maxsweep, int& nsweep, int tag=5557)
+            : SystolicMatrixAlgorithm<T>(A, tag)
+            , n(A.coldim())
+            , tol(tol)
+            , maxsweep(maxsweep)
+            , sweep(nsweep)
+        {
+            MADNESS_ASSERT(A.rowdim() == 3*n);
+            sweep = 0;
+            nrot = 0;
+        }
+
+        void start_iteration_hook(const TaskThreadEnv& env) {
+            if (env.id() == 0) nrot = 0;
+        }
+
+        void end_iteration_hook(const TaskThreadEnv& env) {
+            if (env.id() == 0) {
+                int nr = nrot;
+                SystolicMatrixAlgorithm<T>::get_world().gop.sum(nr);
+                nrot = nr;
+                ++sweep;
+            }
+        }
+
+        bool converged(const TaskThreadEnv& env) const {
+            return nrot == 0 || sweep >= maxsweep;
+        }
+
+        void kernel(int i, int j, T* restrict rowi, T* restrict rowj) {
+            const T* vi = rowi;
+            const T* vj = rowj;
+            const T* ai = rowi + n;
+            const T* aj = rowj + n;
+            const T* bi = rowi + 2*n;
+            const T* bj = rowj + 2*n;
+
+            // Projected 2x2 problem, normalized in the B metric
+            const T si = 1.0/std::sqrt(dot(n, vi, bi));
+            const T sj = 1.0/std::sqrt(dot(n, vj, bj));
+            const T alpha = dot(n, vi, ai)*si*si;
+            const T beta  = dot(n, vj, aj)*sj*sj;
+            const T gamma = dot(n, vi, aj)*si*sj;
+            const T r     = dot(n, vi, bj)*si*sj;
+
+            if (std::abs(r) < tol && std::abs(gamma) <= tol*std::max(std::abs(alpha),std::abs(beta))) return;
+            nrot++;
+
+            // Symmetric orthonormalization X = B2^(-1/2)
+            const T c1 = 1.0/std::sqrt(1.0 + r);
+            const T c2 = 1.0/std::sqrt(1.0 - r);
+            const T xd = 0.5*(c1 + c2);
+            const T xo = 0.5*(c1 - c2);
+
+            // A2' = X A2 X
+            const T a00 = xd*xd*alpha + 2.0*xd*xo*gamma + xo*xo*beta;
+            const T a11 = xo*xo*alpha + 2.0*xd*xo*gamma + xd*xd*beta;
+            const T a01 = xd*xo*(alpha + beta) + (xd*xd + xo*xo)*gamma;
+
+            // Smallest rotation that diagonalizes A2'
+            T c = 1.0, s = 0.0;
+            if (a01 != 0.0) {
+                const T zeta = (a11 - a00)/(2.0*a01);
+                const T t = ((zeta >= 0.0) ? 1.0 : -1.0)/(std::abs(zeta) + std::sqrt(1.0 + zeta*zeta));
+                c = 1.0/std::sqrt(1.0 + t*t);
+                s = t*c;
+            }
+
+            // Columns of diag(si,sj) X R give the new vectors i and j
+            const T t00 = si*(xd*c - xo*s);
+            const T t01 = si*(xd*s + xo*c);
+            const T t10 = sj*(xo*c - xd*s);
+            const T t11 = sj*(xo*s + xd*c);
+
+            for (int64_t k=0; k<3*n; ++k) {
+                const T xi = rowi[k];
+                const T xj = rowj[k];
+                rowi[k] = t00*xi + t10*xj;
+                rowj[k] = t01*xi + t11*xj;
+            }
+        }
+    };
+
+
+    /// Solves the generalized symmetric-definite eigenproblem A v = e B v in parallel
+
+    /// This is a collective call.  The eigenvectors are returned as the
+    /// rows of \c V, i.e., row i of \c V is the eigenvector with eigenvalue
+    /// \c e(i), normalized so that V B V^T = 1.  The eigenvalues are not
+    /// sorted.  Only the eigenvalues are replicated, all matrices remain
+    /// distributed.
+    /// @param[in] A The symmetric matrix (column distributed)
+    /// @param[in] B The symmetric positive definite metric (distributed as A)
+    /// @param[out] V The eigenvectors as rows (distributed as A)
+    /// @param[out] e The eigenvalues (replicated)
+    /// @param[in] tol Convergence threshold for the off-diagonal couplings
+    /// @param[in] maxsweep Maximum number of sweeps
+    /// @return The number of sweeps performed
+    template <typename T>
+    int distributed_sygv(const DistributedMatrix<T>& A, const DistributedMatrix<T>& B,
+                         DistributedMatrix<T>& V, Tensor<T>& e,
+                         const double tol=1e-12, const int maxsweep=30) {
+        World& world = A.get_world();
+        const int64_t n = A.coldim();
+        MADNESS_ASSERT(A.rowdim() == n && A.is_column_distributed());
+        MADNESS_ASSERT(B.coldim() == n && B.rowdim() == n && B.coltile() == A.coltile());
+
+        V = column_distributed_matrix<T>(world, n, n, A.coltile());
+        V.fill_identity();
+        DistributedMatrix<T> W = concatenate_rows(concatenate_rows(V, A), B);
+
+        int nsweep = 0;
+        world.taskq.add(new SystolicJacobiEigensolver<T>(W, tol, maxsweep, nsweep));
+        world.taskq.fence();
+
+        // Eigenvalues are the Rayleigh quotients; normalize the vectors in the B metric
+        e = Tensor<T>(n);
+        W.extract_columns(0, n-1, V);
+        int64_t ilo, ihi;
+        W.local_colrange(ilo, ihi);
+        for (int64_t i=ilo; i<=ihi; ++i) {
+            const T* v = &W.data()(i-ilo,0);
+            T vav = 0, vbv = 0;
+            for (int64_t k=0; k<n; ++k) {
+                vav += v[k]*v[k+n];
+                vbv += v[k]*v[k+2*n];
+            }
+            e(i) = vav/vbv;
+            V.data()(i-ilo,_).scale(1.0/std::sqrt(vbv));
+        }
+        world.gop.sum(e.ptr(), n);
+        return nsweep;
+    }
+
+
+    /// Solves A v = e B v for replicated matrices, distributing the work over all processes
+
+    /// Drop-in replacement for \c sygvp with \c itype=1: each process copies
+    /// only its own rows of \c A and \c B into distributed matrices, the
+    /// Jacobi solver runs on those, and the eigenvectors are replicated
+    /// again at the end.  On return the columns of \c V are the
+    /// eigenvectors and \c e holds the eigenvalues in ascending order.
+    /// @param[in] world The world
+    /// @param[in] A The symmetric matrix (replicated)
+    /// @param[in] B The symmetric positive definite metric (replicated)
+    /// @param[out] V The eigenvectors as columns (replicated)
+    /// @param[out] e The eigenvalues in ascending order (replicated)
+    /// @param[in] tol Convergence threshold for the off-diagonal couplings
+    template <typename T>
+    void sygv_jacobi(World& world, const Tensor<T>& A, const Tensor<T>& B,
+                     Tensor<T>& V, Tensor<T>& e, const double tol=1e-12) {
+        const int64_t n = A.dim(0);
+        DistributedMatrix<T> dA = column_distributed_matrix<T>(world, n, n);
+        DistributedMatrix<T> dB = column_distributed_matrix<T>(world, n, n);
+        dA.copy_from_replicated(A);
+        dB.copy_from_replicated(B);
+
+        DistributedMatrix<T> dV;
+        Tensor<T> evals;
+        distributed_sygv(dA, dB, dV, evals, tol);
+
+        std::vector< std::pair<T,int64_t> > order(n);
+        for (int64_t i=0; i<n; ++i) order[i] = std::make_pair(evals(i), i);
+        std::sort(order.begin(), order.end());
+
+        Tensor<T> vrows(n, n);
+        dV.copy_to_replicated(vrows);
+        V = Tensor<T>(n, n);
+        e = Tensor<T>(n);
+        for (int64_t k=0; k<n; ++k) {
+            e(k) = order[k].first;
+            V(_,k) = vrows(order[k].second,_);
+        }
+    }
+}
+
+#endif
@@ -188,15 +188,17 @@ namespace madness {
         bool has_no_data() const {return not has_data();};
 		long rank() const {return -1;}
 		double svd_normf() const {return this->normf();}
-		size_t real_size() const {return this->size();}
+		size_t real_size() const {return this->size()*sizeof(T);}
 
         void reduce_rank(const double& eps) {return;};
+        void randomized_reduce_rank(const double& eps) {return;};
         void normalize() {return;}
 
         std::string what_am_i() const {return "GenTensor, aliased to Tensor";};
 		TensorType tensor_type() const {return TT_FULL;}
 
 		void add_SVD(const GenTensor<T>& rhs, const double& eps) {*this+=rhs;}
+		void append(GenTensor<T>& rhs, const T fac=1.0) const {rhs.gaxpy(1.0,*this,fac);}
 
 		SRConf<T> config() const {MADNESS_EXCEPTION("no SRConf in complex GenTensor",1);}
         SRConf<T> get_configs(const int& start, const int& end) const {MADNESS_EXCEPTION("no SRConf in complex GenTensor",1);}
@@ -813,6 +815,22 @@ namespace madness {
 			MADNESS_ASSERT(this->_ptr->has_structure() or this->rank()==0);
 		}
 
+		/// reduce the rank of this using a randomized range finder
+
+		/// preferable to reduce_rank if this is an unreduced sum of many terms
+		void randomized_reduce_rank(const double& eps) {
+
+			if (rank()==0) return;
+			if (tensor_type()==TT_FULL or tensor_type()==TT_NONE) {
+				return;
+			} else if (this->tensor_type()==TT_2D) {
+				config().randomized_reduce(eps*facReduce());
+			} else {
+				MADNESS_EXCEPTION("unknown tensor type in GenTensor::randomized_reduce_rank()",0);
+			}
+			MADNESS_ASSERT(this->_ptr->has_structure() or this->rank()==0);
+		}
+
 		/// print this' coefficients
 		void printCoeff(const std::string title) const {
 			print("printing SepRep",title);
@@ -925,6 +943,10 @@ namespace madness {
 
 		/// append this to rhs, shape must conform
 		void append(gentensorT& rhs, const T fac=1.0) const {
+			if (tensor_type()==TT_FULL) {
+				rhs.full_tensor().gaxpy(1.0,full_tensor(),fac);
+				return;
+			}
 			rhs.config().append(*this->_ptr,fac);
 		}
 
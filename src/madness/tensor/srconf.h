@@ -43,6 +43,7 @@
 #include <madness/tensor/tensor.h>
 #include <madness/tensor/clapack.h>
 #include <madness/tensor/tensor_lapack.h>
+#include <madness/constants.h>
 #include <list>
 
 namespace madness {
@@ -460,6 +461,33 @@ namespace madness {
 
 		}
 
+		/// reduce the rank using a randomized range finder, see rr_ortho
+
+		/// much cheaper than orthonormalize() if this is the plain sum of many
+		/// contributions, e.g. after appending the results of an operator
+		/// application to the same destination node
+		void randomized_reduce(const double& thresh) {
+
+			if (type()==TT_FULL) return;
+			if (has_no_data()) return;
+			if (rank()==1) {
+				normalize();
+				return;
+			}
+			normalize();
+			weights_=weights_(Slice(0,rank()-1));
+			tensorT v0=flat_vector(0);
+			tensorT v1=flat_vector(1);
+			rr_ortho(v0,v1,weights_,thresh);
+			std::swap(vector_[0],v0);
+			std::swap(vector_[1],v1);
+			rank_=weights_.size();
+			MADNESS_ASSERT(rank_>=0);
+			this->make_structure();
+			make_slices();
+			MADNESS_ASSERT(has_structure());
+		}
+
 	private:
 		/// append configurations of rhs to this
 
@@ -708,6 +736,22 @@ namespace madness {
 		    return vector_[idim](c0()).reshape(rank(),kVec());
 		}
 
+		/// return a deep copy of one of the vectors with the rank index rotated to the end
+
+		/// the vector (r,k,k,..) becomes (k,k,..,r). Contracting the leading index of
+		/// the result with a matrix (inner(v,c,0,0)) maps to a single contiguous
+		/// matrix multiplication for all ranks together and appends the new index;
+		/// after all physical dimensions have been processed the rank is leading again.
+		/// Assumes the vectors have been shrunk to the rank (e.g. by copy()).
+		tensorT rank_last(const unsigned int& idim) const {
+			const tensorT& v=vector_[idim];
+			MADNESS_ASSERT(v.dim(0)==rank());
+			long d[TENSOR_MAXDIM];
+			for (long i=1; i<v.ndim(); ++i) d[i-1]=v.dim(i);
+			d[v.ndim()-1]=rank();
+			return transpose(v.reshape(rank(),kVec())).reshape(v.ndim(),d);
+		}
+
 		/// fill this SRConf with 1 flattened random configurations (tested)
 		void fillWithRandom(const long& rank=1) {
 
@@ -974,14 +1018,15 @@ namespace madness {
 
 			// these two loops go over all physical dimensions (dim = dim_eff * merged_dim)
 			for (unsigned int idim=0; idim<this->dim_eff(); idim++) {
+				tensorT v=result.rank_last(idim);
 				for (unsigned int jdim=1; jdim<this->ref_vector(idim).ndim(); jdim++) {
 
 					// note: tricky ordering (jdim is missing): this is actually correct!
-					// note: no slicing necessary, since we've copied this to result (incl shrinking)
-//					result.refVector_struct(idim)=madness::inner(result.refVector_struct(idim),c,1,0);
-					result.ref_vector(idim)=madness::inner(result.ref_vector(idim),c,1,0);
-
+					// every contraction over the leading index rotates the new index
+					// to the end, so after the last one the rank is in front again
+					v=madness::inner(v,c,0,0);
 				}
+				result.ref_vector(idim)=v;
 			}
             MADNESS_ASSERT(result.has_structure());
 			return result;
@@ -1013,14 +1058,16 @@ namespace madness {
 			long i=0;
 			// these two loops go over all physical dimensions (dim = dim_eff * merged_dim)
 			for (unsigned int idim=0; idim<this->dim_eff(); idim++) {
+				// all ranks are transformed together, see transform()
+				tensorT v=result.rank_last(idim);
 				for (unsigned int jdim=1; jdim<this->ref_vector(idim).ndim(); jdim++) {
 
 					// note tricky ordering (jdim is missing): this is actually correct!
-					// note: no slicing necessary, since we've copied this to result (incl shrinking)
-					result.ref_vector(idim)=madness::inner(result.ref_vector(idim),c[i],1,0);
+					v=madness::inner(v,c[i],0,0);
 					i++;
 
 				}
+				result.ref_vector(idim)=v;
 			}
             MADNESS_ASSERT(result.has_structure());
 			return result;
@@ -1239,6 +1286,100 @@ namespace madness {
 		return;
 	}
 
+	/// randomized version of ortho3
+
+	/// computes an orthonormal basis Q for the range of A = x^T diag(w) y from
+	/// its action on a few random vectors, and performs the SVD in that basis
+	/// only. The sample size is doubled until a posteriori probing shows that
+	/// the range is captured to within thresh (Halko, Martinsson, Tropp, 2011).
+	/// The result is bi-orthonormal and truncated like the one of ortho3.
+	/// Operation count is O(krl) with l the sample size, compared to
+	/// O(kr^2 + r^3) for ortho3, so this pays off for the large and highly
+	/// redundant ranks that appear when many contributions are summed up.
+	/// Falls back to ortho3 if the sample size approaches the rank.
+	///
+	/// @param[in,out]	x left subspace
+	/// @param[in,out]	y right subspace
+	/// @param[in,out]	weights weights
+	/// @param[in]		thresh	truncation threshold
+	template<typename T>
+	void rr_ortho(Tensor<T>& x, Tensor<T>& y, Tensor<double>& weights, const double& thresh) {
+
+		typedef Tensor<T> tensorT;
+
+		const long rank=x.dim(0);
+		const long kx=x.dim(1);
+		const long ky=y.dim(1);
+		const long maxrank=std::min(std::min(kx,ky),rank);
+
+		// number of probing vectors for the error estimate
+		const long nprobe=4;
+
+		// weighted right subspace: A = x^T wy
+		tensorT wy=copy(y);
+		for (long r=0; r<rank; ++r) wy(r,_).scale(weights(r));
+
+		long l=std::min(long(16),maxrank);
+		tensorT Q;
+		while (true) {
+
+			// not worth it, or the range is (nearly) as large as the rank
+			if (2*l>=rank or l>=maxrank) {
+				ortho3(x,y,weights,thresh);
+				return;
+			}
+
+			// sample the range of A
+			tensorT omega(ky,l+nprobe);
+			omega.fillrandom();
+			omega-=T(0.5);
+			tensorT sample=inner(x,inner(wy,omega),0,0);	// (kx,l+nprobe)
+			tensorT probe=copy(sample(_,Slice(l,-1)));
+			sample=copy(sample(_,Slice(0,l-1)));
+
+			// orthonormal basis of the sampled range, screened for numerical rank
+			tensorT U,VT;
+			Tensor<double> s;
+			svd(sample,U,s,VT);
+			if (s(0L)==0.0) {
+				x.clear();
+				y.clear();
+				weights.clear();
+				return;
+			}
+			long m=0;
+			while (m<s.dim(0) and s(m)>1.e-14*s(0L)) m++;
+			Q=copy(U(_,Slice(0,m-1)));
+
+			// error estimate: || (1 - Q Q^T) A omega ||, amplified for a safe bound
+			probe-=inner(Q,inner(Q,probe,0,0));
+			double err=0.0;
+			for (long i=0; i<nprobe; ++i) err=std::max(err,probe(_,i).normf());
+			err*=10.0*std::sqrt(2.0/constants::pi);
+
+			// the range is exhausted or captured well enough
+			if (m<l or err<0.1*thresh) break;
+			l*=2;
+		}
+
+		// project A onto the range and decompose the small matrix B = Q^T A
+		tensorT B=inner(inner(x,Q),wy,0,0);		// (m,ky)
+		tensorT Ub,VTb;
+		Tensor<double> sb;
+		svd(B,Ub,sb,VTb);
+
+		long i=SRConf<T>::max_sigma(thresh,sb.dim(0),sb);
+		if (i>=0) {
+			x=inner(Ub(_,Slice(0,i)),Q,0,1);
+			y=copy(VTb(Slice(0,i),_));
+			weights=copy(sb(Slice(0,i)));
+		} else {
+			x.clear();
+			y.clear();
+			weights.clear();
+		}
+	}
+
 	/// specialized version of ortho3
 
 	/// does the same as ortho3, but takes two bi-orthonormal configs as input
@@ -0,0 +1,83 @@
+#define WORLD_INSTANTIATE_STATIC_TEMPLATES
+
+#include <madness/madness_config.h>
+#include <madness/world/world.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/tensor_lapack.h>
+#include <madness/tensor/distributed_eigen.h>
+
+using namespace madness;
+
+/// Checks the distributed Jacobi solver against LAPACK and reports timings
+
+/// The matrices mimic a Fock matrix and the overlap of nearly orthonormal
+/// orbitals.  The replicated timing is that of every process doing the
+/// full LAPACK sygv, as in SCF without Elemental.
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+
+    bool ok = true;
+    if (world.rank() == 0) print("      n   nproc  sweeps   jacobi(s)   lapack(s)   max|de|    residual");
+
+    const int64_t sizes[] = {10, 51, 100, 200, 400};
+    for (unsigned int isize=0; isize<sizeof(sizes)/sizeof(int64_t); ++isize) {
+        const int64_t n = sizes[isize];
+
+        // Same random matrices on all processes
+        Tensor<double> A(n,n), B(n,n);
+        if (world.rank() == 0) {
+            A.fillrandom();
+            B.fillrandom();
+            A += transpose(A);
+            B = 0.01*(B + transpose(B));
+            for (int64_t i=0; i<n; ++i) {
+                A(i,i) += double(i)/n;
+                B(i,i) += 1.0;
+            }
+        }
+        world.gop.broadcast(A.ptr(), A.size(), 0);
+        world.gop.broadcast(B.ptr(), B.size(), 0);
+
+        world.gop.fence();
+        double start = wall_time();
+        Tensor<double> V, e;
+        sygv_jacobi(world, A, B, V, e);
+        world.gop.fence();
+        const double tjacobi = wall_time() - start;
+
+        start = wall_time();
+        Tensor<double> Vref, eref;
+        sygv(A, B, 1, Vref, eref);
+        const double tlapack = wall_time() - start;
+
+        // Residual ||A V - B V e|| and orthonormality ||V^T B V - 1||
+        Tensor<double> BV = inner(B, V);
+        Tensor<double> R = inner(A, V);
+        for (int64_t k=0; k<n; ++k) R(_,k).gaxpy(1.0, BV(_,k), -e(k));
+        Tensor<double> S = inner(transpose(V), BV);
+        for (int64_t k=0; k<n; ++k) S(k,k) -= 1.0;
+        const double residual = std::max(R.absmax(), S.absmax());
+        const double de = (e - eref).absmax();
+
+        // Also the number of sweeps from the distributed interface
+        DistributedMatrix<double> dA = column_distributed_matrix<double>(world, n, n);
+        DistributedMatrix<double> dB = column_distributed_matrix<double>(world, n, n);
+        dA.copy_from_replicated(A);
+        dB.copy_from_replicated(B);
+        DistributedMatrix<double> dV;
+        Tensor<double> evals;
+        const int nsweep = distributed_sygv(dA, dB, dV, evals);
+
+        if (world.rank() == 0)
+            printf("%7ld %7d %7d %11.3f %11.3f %11.2e %11.2e\n", long(n), world.size(),
+                   nsweep, tjacobi, tlapack, de, residual);
+        if (de > 1e-10 || residual > 1e-10) ok = false;
+    }
+
+    if (world.rank() == 0) print(ok ? "distributed eigensolver OK" : "distributed eigensolver FAILED");
+
+    world.gop.fence();
+    finalize();
+    return ok ? 0 : 1;
+}
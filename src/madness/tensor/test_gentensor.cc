@@ -243,6 +243,25 @@ namespace {
     	}
     }
 
+    // deferred addition: append unreduced terms, then reduce them all at once
+    TEST_P(BinaryGenTest, DeferredAddition) {
+    	try {
+    		for (int ipass=0; ipass<10; ++ipass) {
+    			t0+=t1;
+    			g1.append(g0);
+    		}
+    		g0.randomized_reduce_rank(eps);
+    		ASSERT_LT((g0.full_tensor_copy()-t0).normf(),eps);
+
+    	} catch (const madness::TensorException& e) {
+    		if (dim.size() != 0) std::cout << e;
+    		EXPECT_EQ(dim.size(),0);
+    	} catch(...) {
+    		std::cout << "Caught unknown exception" << std::endl;
+    		EXPECT_EQ(1,0);
+    	}
+    }
+
     TEST_P(BinaryGenTest, ScalarMultiplication) {
     	try {
     		// check for multiplication
@@ -87,9 +87,11 @@ namespace madness {
     // Not all of these functions are defined for all types.
     // Unfortunately, in the current version, some misuses will only be
     // detected at run time.
+    //
+    // low_precision_type = the type used to store data in reduced precision
 
 
-#define TYPEINFO(num, T, iscmplx, mcpyok, realT,floatrealT) \
+#define TYPEINFO(num, T, iscmplx, mcpyok, realT,floatrealT,lowT) \
 template<> class TensorTypeData<T> {\
 public: \
   enum {id = num}; \
@@ -99,21 +101,22 @@ public: \
   typedef T type; \
   typedef realT scalar_type; \
   typedef floatrealT float_scalar_type; \
+  typedef lowT low_precision_type; \
 }; \
 template<> class TensorTypeFromId<num> {\
 public: \
   typedef T type; \
 }
 
-    TYPEINFO(0,int,false,true,int,double);
-    TYPEINFO(1,long,false,true,long,double);
-    TYPEINFO(2,float,false,true,float,float);
-    TYPEINFO(3,double,false,true,double,double);
-    TYPEINFO(4,float_complex,true,true,float,float);
-    TYPEINFO(5,double_complex,true,true,double,double);
+    TYPEINFO(0,int,false,true,int,double,int);
+    TYPEINFO(1,long,false,true,long,double,long);
+    TYPEINFO(2,float,false,true,float,float,float);
+    TYPEINFO(3,double,false,true,double,double,float);
+    TYPEINFO(4,float_complex,true,true,float,float,float_complex);
+    TYPEINFO(5,double_complex,true,true,double,double,float_complex);
 
 #ifdef HAVE_LONG_LONG
-    TYPEINFO(6,long long,false,true,long long,double);
+    TYPEINFO(6,long long,false,true,long long,double,long long);
 #define TENSOR_MAX_TYPE_ID 6
 #else
 #define TENSOR_MAX_TYPE_ID 5
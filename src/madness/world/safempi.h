@@ -551,6 +551,26 @@ namespace SafeMPI {
             return Intracomm(std::shared_ptr<Impl>(new Impl(group_comm, me, nproc, true)));
         }
 
+        /**
+         * This collective operation partitions this \c Intracomm into
+         * disjoint sub-communicators, one for each value of \c color.
+         * Must be called by all processes that belong to this communicator.
+         *
+         * @param color processes with the same color end up in the same
+         *   Intracomm
+         * @param key determines the rank order in the new Intracomm
+         * @return a new Intracomm object
+         */
+        Intracomm Split(const int color, const int key) const {
+            MADNESS_ASSERT(pimpl);
+            SAFE_MPI_GLOBAL_MUTEX;
+            MPI_Comm split_comm;
+            MADNESS_MPI_TEST(MPI_Comm_split(pimpl->comm, color, key, &split_comm));
+            int me; MADNESS_MPI_TEST(MPI_Comm_rank(split_comm, &me));
+            int nproc; MADNESS_MPI_TEST(MPI_Comm_size(split_comm, &nproc));
+            return Intracomm(std::shared_ptr<Impl>(new Impl(split_comm, me, nproc, true)));
+        }
+
         bool operator==(const Intracomm& other) const {
             return (pimpl == other.pimpl) || ((pimpl && other.pimpl) &&
                     Comm_compare(pimpl->comm, other.pimpl->comm));
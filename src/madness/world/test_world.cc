@@ -1137,6 +1137,31 @@ void test_multi_world(World& world) {
     world.gop.fence();
 }
 
+void test_split_world(World& world) {
+    if (world.size() < 2) return;
+
+    // Split into three worlds by rank modulo 3; every process must
+    // participate in the split.
+    const int color = world.rank() % 3;
+    SafeMPI::Intracomm comm = world.mpi.comm().Split(color, world.rank());
+    {
+        World subworld(comm);
+        int nsub = 0;
+        for (int i=0; i<world.size(); ++i) if (i%3 == color) ++nsub;
+        MADNESS_ASSERT(subworld.size() == nsub);
+        MADNESS_ASSERT(subworld.rank() == world.rank()/3);
+
+        long sum = world.rank();
+        subworld.gop.sum(sum);
+        long expected = 0;
+        for (int i=color; i<world.size(); i+=3) expected += i;
+        MADNESS_ASSERT(sum == expected);
+        subworld.gop.fence();
+    }
+
+    world.gop.fence();
+}
+
 #if  MADNESS_CATCH_SIGNALS
 void mad_signal_handler( int signum ) {
   // announce the signal
@@ -1192,6 +1217,7 @@ int main(int argc, char** argv) {
           print("REPETITION",i);
           test_multi_world(world);
         }
+        test_split_world(world);
     }
     catch (SafeMPI::Exception e) {
         print(e);